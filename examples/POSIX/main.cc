@@ -76,6 +76,9 @@ int main( int argc, char* argv[] )
         goto shutdown;
     }
 
+    // Route explicit requests by table lookups from here on
+    FreezeCipDispatch();
+
     // Setup Network Handles
     if( NetworkHandlerInitialize() != kEipStatusOk )
     {
@@ -103,6 +106,10 @@ int main( int argc, char* argv[] )
 
     printf( "\ncleaning up and ending...\n" );
 
+#if CIPSTER_USE_RECVMMSG
+    NetworkHandlerShowStats();
+#endif
+
     // clean up network state
     NetworkHandlerFinish();
 
@@ -8,8 +8,25 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
 #include <sys/time.h>
 #include <time.h>
+#include <algorithm>
+#include <vector>
+
+#if CIPSTER_USE_EPOLL
+ #include <sys/epoll.h>
+#endif
+
+#include <sys/socket.h>
+
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+ #include <sys/prctl.h>
+ #if CIPSTER_USE_EPOLL
+  #include <sys/timerfd.h>
+ #endif
+#endif
 
 #include "networkhandler.h"
 
@@ -34,14 +51,154 @@ static EipByte s_packet[CIPSTER_ETHERNET_BUFFER_SIZE];
 
 #define MAX_NO_OF_TCP_SOCKETS           10
 
-typedef unsigned  MicroSeconds;
+typedef EipUint64 MicroSeconds;
+
+
+/// Unsent reply bytes at which a TCP session stops taking new requests
+#define TCP_TX_QUEUE_LIMIT              (8 * CIPSTER_ETHERNET_BUFFER_SIZE)
+
+/**
+ * Struct TcpSession
+ * holds the receive and transmit state of one TCP session.
+ *
+ * Received bytes collect in rx until they form complete encapsulation
+ * packets.  A packet may arrive in pieces over several wakeups, and one
+ * read may bring several packets.  Replies are serialized straight into tx
+ * and go out together when the socket takes them, so a reply is never
+ * lost to a short send().
+ */
+struct TcpSession
+{
+    TcpSession() :
+        rx_count( 0 ),
+        rx_discard( 0 ),
+        tx_head( 0 ),
+        tx_replies( 0 ),
+        want_read( true ),
+        want_write( false ),
+        corked( false )
+    {}
+
+    /// Function TxPending returns the count of queued reply bytes not yet sent.
+    unsigned TxPending() const  { return tx.size() - tx_head; }
+
+    EipByte     rx[CIPSTER_ETHERNET_BUFFER_SIZE];
+    unsigned    rx_count;       ///< bytes held in rx[]
+    unsigned    rx_discard;     ///< bytes yet to skip of a packet too big for rx[]
+
+    std::vector<EipByte> tx;    ///< replies, those before tx_head are sent
+    unsigned    tx_head;
+    unsigned    tx_replies;     ///< replies queued since tx was last empty
+
+    bool        want_read;      ///< currently waiting for the socket to be readable
+    bool        want_write;     ///< currently waiting for the socket to be writable
+    bool        corked;         ///< TCP_CORK is set, see flushTcpSession()
+};
+
+// indexed by TCP socket, created when the session is accepted
+static std::vector<TcpSession*> tcp_sessions;
+
+
+/// What a watched socket is used for, decides how received data is handled.
+enum SocketKind
+{
+    kSocketUnused,
+    kSocketTcpListener,
+    kSocketUdpUnicastListener,
+    kSocketUdpLocalBroadcastListener,
+    kSocketUdpGlobalBroadcastListener,
+    kSocketTcpSession,
+    kSocketUdpConsuming,
+    kSocketWakeupTimer,
+};
+
+#if CIPSTER_USE_EPOLL
+
+/// Max number of ready events taken from the kernel in one epoll_wait() call
+#define EPOLL_MAX_EVENTS                64
+
+/**
+ * Struct SocketSlot
+ * is the per file descriptor registration used by the epoll backend.
+ * It lets a ready socket go straight to its handler, and for a consuming
+ * UDP socket straight to its CipConn.
+ */
+struct SocketSlot
+{
+    SocketSlot() :
+        kind( kSocketUnused ),
+        ready( false ),
+        conn( NULL )
+    {}
+
+    SocketKind  kind;
+    bool        ready;      ///< reported by the last epoll_wait(), not yet handled
+    CipConn*    conn;       ///< owner of a kSocketUdpConsuming, found on first use
+};
+
+static int epoll_fd = -1;
+
+// indexed by file descriptor, so there is no FD_SETSIZE limit
+static std::vector<SocketSlot> socket_slots;
+
+#else
 
 static fd_set master_set;
 static fd_set read_set;
 
+// TCP sessions with unsent replies
+static fd_set write_master_set;
+static fd_set write_set;
+
 // temporary file descriptor for select()
 static int highest_socket_handle;
 
+#endif
+
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+
+/// When NetworkHandlerProcessOnce() has to wake up at the latest.
+static MicroSeconds next_wakeup_usecs;
+
+ #if CIPSTER_USE_EPOLL
+// CLOCK_MONOTONIC timerfd in the epoll set, expiring at next_wakeup_usecs
+static int wakeup_fd = -1;
+ #endif
+
+#endif
+
+#if CIPSTER_USE_RECVMMSG
+
+/// Max number of class 0/1 packets taken from a consuming socket per recvmmsg() call
+#define UDP_RECV_BATCH_SIZE             16
+
+/*  One set of batch buffers is shared by all consuming sockets, since a
+    socket's batch is fully dispatched before the next socket is read.
+    Packets are batch_stride bytes apart, enough for the largest connection
+    size negotiated so far and a byte more, by which a longer one is told.
+*/
+static std::vector<EipByte> batch_packets;
+static int          batch_stride;
+static sockaddr_in  batch_from[UDP_RECV_BATCH_SIZE];
+static iovec        batch_iov[UDP_RECV_BATCH_SIZE];
+static mmsghdr      batch_msgs[UDP_RECV_BATCH_SIZE];
+
+/**
+ * Struct RecvBatchStats
+ * tells how full the recvmmsg() batches are, for sizing UDP_RECV_BATCH_SIZE.
+ */
+struct RecvBatchStats
+{
+    unsigned    calls;          ///< recvmmsg() calls which returned packets
+    unsigned    packets;        ///< total packets received by those calls
+    unsigned    max_batch;      ///< largest batch seen
+    unsigned    histogram[UDP_RECV_BATCH_SIZE + 1];    ///< calls by batch size
+};
+
+static RecvBatchStats recv_batch_stats;
+
+#endif
+
 /** @brief This variable holds the TCP socket the received to last explicit message.
  * It is needed for opening point to point connection to determine the peer's
  * address.
@@ -84,6 +241,10 @@ EipStatus HandleDataOnTcpSocket( int socket );
 
 int GetMaxSocket( int socket1, int socket2, int socket3, int socket4 );
 
+static void handleConsumingUdpSocket( CipConn* aConn );
+
+static EipStatus handleWritableTcpSocket( int socket );
+
 const std::string strerrno()
 {
     char    buf[256];
@@ -116,13 +277,179 @@ struct NetworkStatus
 
 static NetworkStatus g_sockets;
 
+
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+
+/**
+ * Function armWakeup
+ * expires the connection timers and sends the delayed replies due by now,
+ * then sets next_wakeup_usecs to the next such deadline or the next
+ * CIPSTER_TIMER_TICK, whichever comes first.
+ */
+static void armWakeup()
+{
+    MicroSeconds now = GetMicroSeconds();
+
+    MicroSeconds next_tick = g_last_time_usecs + kOpenerTimerTickInMicroSeconds -
+                                g_sockets.elapsed_time_usecs;
+
+    next_wakeup_usecs = std::min( (MicroSeconds) ManageConnectionTimers( now ), next_tick );
+
+ #if CIPSTER_USE_EPOLL
+    itimerspec  spec;
+
+    memset( &spec, 0, sizeof spec );
+
+    // zero would disarm the timer, a deadline already past fires at once
+    spec.it_value.tv_sec  = next_wakeup_usecs / 1000000;
+    spec.it_value.tv_nsec = ( next_wakeup_usecs % 1000000 ) * 1000 + 1;
+
+    if( timerfd_settime( wakeup_fd, TFD_TIMER_ABSTIME, &spec, NULL ) == -1 )
+    {
+        CIPSTER_TRACE_ERR( "%s: error with timerfd_settime: %s\n",
+            __func__, strerrno().c_str() );
+    }
+ #endif
+}
+
+#endif
+
+
+/**
+ * Function runDueConnectionTimers
+ * produces and times out what came due meanwhile.  Called between explicit
+ * messages, so a slow one delays class 0/1 I/O by its own duration only,
+ * not by that of everything else which was ready in the same wakeup.
+ */
+static inline void runDueConnectionTimers()
+{
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    ManageConnectionTimers( GetMicroSeconds() );
+#endif
+}
+
+
+/**
+ * Function watchSocket
+ * adds @a socket to the set of sockets checked for received data.
+ * @param aKind tells how data on the socket is to be handled.
+ */
+static void watchSocket( int socket, SocketKind aKind )
+{
+#if CIPSTER_USE_EPOLL
+    if( socket >= (int) socket_slots.size() )
+        socket_slots.resize( socket + 1 );
+
+    epoll_event ev;
+
+    ev.events  = EPOLLIN;
+    ev.data.fd = socket;
+
+    if( epoll_ctl( epoll_fd, EPOLL_CTL_ADD, socket, &ev ) == -1 )
+    {
+        CIPSTER_TRACE_ERR( "%s: error adding socket %d to epoll set: %s\n",
+            __func__, socket, strerrno().c_str() );
+        return;
+    }
+
+    SocketSlot& slot = socket_slots[socket];
+
+    slot.kind  = aKind;
+    slot.ready = false;
+    slot.conn  = NULL;
+#else
+    (void) aKind;
+
+    FD_SET( socket, &master_set );
+
+    if( socket > highest_socket_handle )
+    {
+        highest_socket_handle = socket;
+    }
+#endif
+}
+
+
+/**
+ * Function unwatchSocket
+ * removes @a socket from the set of sockets checked for received data.
+ * It is harmless to call this for a socket which is not watched.
+ */
+static void unwatchSocket( int socket )
+{
+#if CIPSTER_USE_EPOLL
+    if( socket < (int) socket_slots.size() && socket_slots[socket].kind != kSocketUnused )
+    {
+        epoll_ctl( epoll_fd, EPOLL_CTL_DEL, socket, NULL );
+
+        socket_slots[socket] = SocketSlot();
+    }
+#else
+    FD_CLR( socket, &master_set );
+    FD_CLR( socket, &write_master_set );
+#endif
+}
+
+
+/**
+ * Function setTcpSessionInterest
+ * chooses whether to wait for the TCP session @a socket to become readable,
+ * writable, or both.
+ */
+static void setTcpSessionInterest( int socket, TcpSession* aSession, bool aRead, bool aWrite )
+{
+    if( aRead == aSession->want_read && aWrite == aSession->want_write )
+        return;
+
+#if CIPSTER_USE_EPOLL
+    epoll_event ev;
+
+    ev.events  = ( aRead ? EPOLLIN : 0 ) | ( aWrite ? EPOLLOUT : 0 );
+    ev.data.fd = socket;
+
+    if( epoll_ctl( epoll_fd, EPOLL_CTL_MOD, socket, &ev ) == -1 )
+    {
+        CIPSTER_TRACE_ERR( "%s: error changing socket %d in epoll set: %s\n",
+            __func__, socket, strerrno().c_str() );
+        return;
+    }
+#else
+    if( aRead )
+        FD_SET( socket, &master_set );
+    else
+        FD_CLR( socket, &master_set );
+
+    if( aWrite )
+        FD_SET( socket, &write_master_set );
+    else
+        FD_CLR( socket, &write_master_set );
+#endif
+
+    aSession->want_read  = aRead;
+    aSession->want_write = aWrite;
+}
+
+
 EipStatus NetworkHandlerInitialize()
 {
     static const int one = 1;
 
+#if CIPSTER_USE_EPOLL
+    epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+
+    if( epoll_fd == -1 )
+    {
+        CIPSTER_TRACE_ERR( "%s: error with epoll_create1: %s\n",
+                __func__, strerrno().c_str() );
+        return kEipStatusError;
+    }
+#else
     // clear the master an temp sets
     FD_ZERO( &master_set );
     FD_ZERO( &read_set );
+    FD_ZERO( &write_master_set );
+    FD_ZERO( &write_set );
+#endif
 
     g_sockets.tcp_listener = -1;
     g_sockets.udp_unicast_listener = -1;
@@ -290,18 +617,11 @@ EipStatus NetworkHandlerInitialize()
         goto error;
     }
 
-    // add the listener socket to the master set
-    FD_SET( g_sockets.tcp_listener, &master_set );
-    FD_SET( g_sockets.udp_unicast_listener, &master_set );
-    FD_SET( g_sockets.udp_local_broadcast_listener, &master_set );
-    FD_SET( g_sockets.udp_global_broadcast_listener, &master_set );
-
-    // keep track of the biggest file descriptor
-    highest_socket_handle = GetMaxSocket(
-            g_sockets.tcp_listener,
-            g_sockets.udp_global_broadcast_listener,
-            g_sockets.udp_local_broadcast_listener,
-            g_sockets.udp_unicast_listener );
+    // add the listener sockets to the watched set
+    watchSocket( g_sockets.tcp_listener, kSocketTcpListener );
+    watchSocket( g_sockets.udp_unicast_listener, kSocketUdpUnicastListener );
+    watchSocket( g_sockets.udp_local_broadcast_listener, kSocketUdpLocalBroadcastListener );
+    watchSocket( g_sockets.udp_global_broadcast_listener, kSocketUdpGlobalBroadcastListener );
 
     CIPSTER_TRACE_INFO( "%s:\n"
         " tcp_listener                 :%d\n"
@@ -318,6 +638,27 @@ EipStatus NetworkHandlerInitialize()
     g_last_time_usecs = GetMicroSeconds();    // initialize time keeping
     g_sockets.elapsed_time_usecs = 0;
 
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    // the default 50 usecs of timer slack is a lot compared to a 250 usec RPI
+    prctl( PR_SET_TIMERSLACK, 1 );
+
+ #if CIPSTER_USE_EPOLL
+    wakeup_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+
+    if( wakeup_fd == -1 )
+    {
+        CIPSTER_TRACE_ERR( "%s: error with timerfd_create: %s\n",
+                __func__, strerrno().c_str() );
+        goto error;
+    }
+
+    watchSocket( wakeup_fd, kSocketWakeupTimer );
+ #endif
+
+    // switches the connection timers to their deadlines
+    armWakeup();
+#endif
+
     return kEipStatusOk;
 
 error:
@@ -326,16 +667,212 @@ error:
 }
 
 
+#if CIPSTER_USE_EPOLL
+
+/**
+ * Function findConsumingConn
+ * returns the active connection which consumes on @a socket, or NULL.
+ */
+static CipConn* findConsumingConn( int socket )
+{
+    for( CipConn* conn = g_active_connection_list;  conn;  conn = conn->next )
+    {
+        if( conn->consuming_socket == socket )
+            return conn;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Function isIoSocket
+ * tells if @a aKind carries class 0/1 I/O or connection timing, which
+ * go before explicit messaging.
+ */
+static bool isIoSocket( SocketKind aKind )
+{
+    return aKind == kSocketUdpConsuming
+        || aKind == kSocketWakeupTimer;
+}
+
+
+/**
+ * Function dispatchSocket
+ * hands one socket reported by epoll_wait() to its handler.
+ */
+static void dispatchSocket( const epoll_event& aEvent )
+{
+    int socket = aEvent.data.fd;
+
+    switch( socket_slots[socket].kind )
+    {
+    case kSocketTcpListener:
+        CheckAndHandleTcpListenerSocket();
+        break;
+
+    case kSocketUdpUnicastListener:
+        CheckAndHandleUdpUnicastSocket();
+        break;
+
+    case kSocketUdpLocalBroadcastListener:
+        CheckAndHandleUdpLocalBroadcastSocket();
+        break;
+
+    case kSocketUdpGlobalBroadcastListener:
+        CheckAndHandleUdpGlobalBroadcastSocket();
+        break;
+
+    case kSocketUdpConsuming:
+        if( CheckSocketSet( socket ) )
+        {
+            SocketSlot& slot = socket_slots[socket];
+
+            if( !slot.conn )
+                slot.conn = findConsumingConn( socket );
+
+            if( slot.conn )
+                handleConsumingUdpSocket( slot.conn );
+            else
+            {
+                CIPSTER_TRACE_WARN( "%s: no connection for UDP socket %d\n",
+                    __func__, socket );
+            }
+        }
+        break;
+
+    case kSocketTcpSession:
+        {
+            EipStatus status = kEipStatusOk;
+
+            if( aEvent.events & EPOLLOUT )
+                status = handleWritableTcpSocket( socket );
+
+            if( status != kEipStatusError && CheckSocketSet( socket ) )
+                status = HandleDataOnTcpSocket( socket );
+
+            if( kEipStatusError == status ) // if error
+            {
+                CloseSocket( socket );
+                CloseSession( socket ); // clean up session and close the socket
+            }
+        }
+        break;
+
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    case kSocketWakeupTimer:
+        if( CheckSocketSet( socket ) )
+        {
+            uint64_t expirations;
+
+            // only clears the readiness, armWakeup() sets the next expiry
+            if( read( socket, &expirations, sizeof expirations ) < 0 && errno != EAGAIN )
+            {
+                CIPSTER_TRACE_ERR( "%s: error reading timerfd: %s\n",
+                    __func__, strerrno().c_str() );
+            }
+        }
+        break;
+#endif
+
+    default:    // closed by an earlier handler in this pass
+        break;
+    }
+}
+
+
+/**
+ * Function dispatchReadySockets
+ * waits up to @a aTimeoutMSecs (-1 is forever, 0 is just a poll) for received
+ * data and hands each ready socket directly to its handler, so the cost is
+ * proportional to the number of ready sockets rather than to the number of
+ * open ones.
+ */
+static EipStatus dispatchReadySockets( int aTimeoutMSecs )
+{
+    epoll_event events[EPOLL_MAX_EVENTS];
+
+    int ready_count = epoll_wait( epoll_fd, events, DIM( events ), aTimeoutMSecs );
+
+    if( ready_count == -1 )
+    {
+        if( EINTR == errno )
+        {
+            // interrupted, try again next time around
+            return kEipStatusOk;
+        }
+        else
+        {
+            CIPSTER_TRACE_ERR( "%s: error with epoll_wait: %s\n",
+                    __func__, strerrno().c_str() );
+            return kEipStatusError;
+        }
+    }
+
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    // produce what came due during the wait before handling received data,
+    // which then also resets the watchdogs against a fresh time
+    ManageConnectionTimers( GetMicroSeconds() );
+#endif
+
+    // mark all first, a handler may close a socket which is later in events[]
+    for( int i = 0; i < ready_count; ++i )
+    {
+        if( events[i].events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) )
+            socket_slots[events[i].data.fd].ready = true;
+    }
+
+    // class 0/1 first, so explicit messages wait for I/O rather than the reverse
+    for( int i = 0; i < ready_count; ++i )
+    {
+        if( isIoSocket( socket_slots[events[i].data.fd].kind ) )
+            dispatchSocket( events[i] );
+    }
+
+    for( int i = 0; i < ready_count; ++i )
+    {
+        if( !isIoSocket( socket_slots[events[i].data.fd].kind ) )
+        {
+            dispatchSocket( events[i] );
+            runDueConnectionTimers();
+        }
+    }
+
+    return kEipStatusOk;
+}
+
+#endif
+
+
 EipStatus NetworkHandlerProcessOnce()
 {
-    read_set = master_set;
+#if CIPSTER_USE_EPOLL
+ #if CIPSTER_USE_DEADLINE_SCHEDULER
+    // the wakeup timer ends the wait at next_wakeup_usecs
+    if( kEipStatusError == dispatchReadySockets( -1 ) )
+        return kEipStatusError;
+ #else
+    if( kEipStatusError == dispatchReadySockets( 0 ) )
+        return kEipStatusError;
+ #endif
+#else
+    read_set  = master_set;
+    write_set = write_master_set;
 
     struct timeval tv;
 
+ #if CIPSTER_USE_DEADLINE_SCHEDULER
+    MicroSeconds now  = GetMicroSeconds();
+    MicroSeconds wait = next_wakeup_usecs > now ? next_wakeup_usecs - now : 0;
+
+    tv.tv_sec  = wait / 1000000;
+    tv.tv_usec = wait % 1000000;
+ #else
     tv.tv_sec = 0;
     tv.tv_usec = 0;
+ #endif
 
-    int ready_socket = select( highest_socket_handle + 1, &read_set, 0, 0, &tv );
+    int ready_socket = select( highest_socket_handle + 1, &read_set, &write_set, 0, &tv );
 
     if( ready_socket == kEipInvalidSocket )
     {
@@ -354,13 +891,37 @@ EipStatus NetworkHandlerProcessOnce()
         }
     }
 
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    // produce what came due during the wait before handling received data,
+    // which then also resets the watchdogs against a fresh time
+    ManageConnectionTimers( GetMicroSeconds() );
+#endif
+
     if( ready_socket > 0 )
     {
+        // class 0/1 first, so explicit messages wait for I/O rather than the reverse
+        CheckAndHandleConsumingUdpSockets();
+
+        // send queued replies, which may let a session take requests again
+        for( int socket = 0; socket <= highest_socket_handle; socket++ )
+        {
+            if( FD_ISSET( socket, &write_set ) )
+            {
+                if( kEipStatusError == handleWritableTcpSocket( socket ) )
+                {
+                    CloseSocket( socket );
+                    CloseSession( socket ); // clean up session and close the socket
+                }
+
+                runDueConnectionTimers();
+            }
+        }
+
         CheckAndHandleTcpListenerSocket();
         CheckAndHandleUdpUnicastSocket();
         CheckAndHandleUdpLocalBroadcastSocket();
         CheckAndHandleUdpGlobalBroadcastSocket();
-        CheckAndHandleConsumingUdpSockets();
+        runDueConnectionTimers();
 
         for( int socket = 0; socket <= highest_socket_handle; socket++ )
         {
@@ -372,10 +933,14 @@ EipStatus NetworkHandlerProcessOnce()
                     CloseSocket( socket );
                     CloseSession( socket ); // clean up session and close the socket
                 }
+
+                runDueConnectionTimers();
             }
         }
     }
 
+#endif
+
     g_actual_time_usecs = GetMicroSeconds();
     g_sockets.elapsed_time_usecs += g_actual_time_usecs - g_last_time_usecs;
     g_last_time_usecs = g_actual_time_usecs;
@@ -390,6 +955,10 @@ EipStatus NetworkHandlerProcessOnce()
         g_sockets.elapsed_time_usecs -= kOpenerTimerTickInMicroSeconds;
     }
 
+#if CIPSTER_USE_DEADLINE_SCHEDULER
+    armWakeup();
+#endif
+
     return kEipStatusOk;
 }
 
@@ -401,6 +970,23 @@ EipStatus NetworkHandlerFinish()
     CloseSocket( g_sockets.udp_local_broadcast_listener );
     CloseSocket( g_sockets.udp_global_broadcast_listener );
 
+#if CIPSTER_USE_DEADLINE_SCHEDULER && CIPSTER_USE_EPOLL
+    if( wakeup_fd != -1 )
+    {
+        unwatchSocket( wakeup_fd );
+        close( wakeup_fd );
+        wakeup_fd = -1;
+    }
+#endif
+
+#if CIPSTER_USE_EPOLL
+    if( epoll_fd != -1 )
+    {
+        close( epoll_fd );
+        epoll_fd = -1;
+    }
+#endif
+
     return kEipStatusOk;
 }
 
@@ -409,6 +995,16 @@ bool CheckSocketSet( int socket )
 {
     bool return_value = false;
 
+#if CIPSTER_USE_EPOLL
+    // a socket closed earlier in this pass has a cleared slot, so is not ready
+    if( socket >= 0 && socket < (int) socket_slots.size() && socket_slots[socket].ready )
+    {
+        return_value = true;
+
+        // so that later checks will not find it
+        socket_slots[socket].ready = false;
+    }
+#else
     if( FD_ISSET( socket, &read_set ) )
     {
         if( FD_ISSET( socket, &master_set ) )
@@ -423,6 +1019,7 @@ bool CheckSocketSet( int socket )
         FD_CLR( socket, &read_set );
         // remove it from the read set so that later checks will not find it
     }
+#endif
 
     return return_value;
 }
@@ -456,10 +1053,100 @@ EipStatus SendUdpData( struct sockaddr_in* address, int socket, BufReader aOutpu
 }
 
 
-#if defined(DEBUG)
-static void dump( const char* aPrompt, EipByte* aBytes, int aCount )
+/**
+ * Function setUdpSendItemMsg
+ * fills @a aMsg to gather the header and data of @a aItem, using aIov[0..1].
+ */
+static void setUdpSendItemMsg( msghdr* aMsg, iovec* aIov, const UdpSendItem& aItem )
 {
-    int len = printf( "%s:", aPrompt );
+    aIov[0].iov_base = (void*) aItem.header.data();
+    aIov[0].iov_len  = aItem.header.size();
+    aIov[1].iov_base = (void*) aItem.data.data();
+    aIov[1].iov_len  = aItem.data.size();
+
+    memset( aMsg, 0, sizeof *aMsg );
+    aMsg->msg_name    = aItem.address;
+    aMsg->msg_namelen = sizeof *aItem.address;
+    aMsg->msg_iov     = aIov;
+    aMsg->msg_iovlen  = 2;
+}
+
+
+void SendUdpDataBatch( UdpSendItem* aItems, int aCount )
+{
+#if CIPSTER_USE_SENDMMSG
+    mmsghdr msgs[32];
+    iovec   iov[DIM( msgs )][2];
+
+    int i = 0;
+
+    while( i < aCount )
+    {
+        int socket = aItems[i].socket;
+        int count;
+
+        // gather the adjacent items which use this socket
+        for( count = 0; count < DIM( msgs ) && i + count < aCount &&
+                aItems[i + count].socket == socket;  ++count )
+        {
+            setUdpSendItemMsg( &msgs[count].msg_hdr, iov[count], aItems[i + count] );
+        }
+
+        int sent = sendmmsg( socket, msgs, count, 0 );
+
+        CIPSTER_TRACE_INFO( "%s: socket:%d sent %d of %d datagrams\n",
+            __func__, socket, sent, count );
+
+        if( sent < 0 )
+        {
+            CIPSTER_TRACE_ERR( "%s: error with sendmmsg: %s\n",
+                    __func__, strerrno().c_str() );
+
+            // The first datagram failed, skip only it.
+            aItems[i++].result = kEipStatusError;
+            continue;
+        }
+
+        for( int j = 0; j < sent;  ++j )
+        {
+            UdpSendItem& item = aItems[i + j];
+
+            item.result = msgs[j].msg_len == item.header.size() + item.data.size() ?
+                                    kEipStatusOk : kEipStatusError;
+        }
+
+        // If fewer than count were sent, the next one failed and
+        // the next call reports that error.
+        i += sent;
+    }
+#else
+    for( int i = 0; i < aCount;  ++i )
+    {
+        UdpSendItem&    item = aItems[i];
+        msghdr          msg;
+        iovec           iov[2];
+
+        setUdpSendItemMsg( &msg, iov, item );
+
+        int sent_count = sendmsg( item.socket, &msg, 0 );
+
+        if( sent_count < 0 )
+        {
+            CIPSTER_TRACE_ERR( "%s: error with sendmsg: %s\n",
+                    __func__, strerrno().c_str() );
+        }
+
+        item.result = sent_count == (int) ( item.header.size() + item.data.size() ) ?
+                        kEipStatusOk : kEipStatusError;
+    }
+#endif
+}
+
+
+#if defined(DEBUG)
+static void dump( const char* aPrompt, EipByte* aBytes, int aCount )
+{
+    int len = printf( "%s:", aPrompt );
 
     for( int i = 0; i < aCount;  ++i )
     {
@@ -474,163 +1161,296 @@ static void dump( const char* aPrompt, EipByte* aBytes, int aCount )
 #endif
 
 
-static int ensuredRead(  int sock, EipByte* where, int count )
+/**
+ * Function setTcpSessionCork
+ * sets or clears TCP_CORK on the TCP session @a socket, if not already so.
+ */
+static void setTcpSessionCork( int socket, TcpSession* aSession, bool aCork )
 {
-    int i;
-    int numRead;
+#if defined(TCP_CORK)
+    if( aCork == aSession->corked )
+        return;
 
-    for( i=0;  i < count;  i += numRead )
+    int value = aCork;
+
+    if( setsockopt( socket, IPPROTO_TCP, TCP_CORK, &value, sizeof value ) == -1 )
     {
-        numRead = recv( sock, where+i, count - i, 0 );
-        if( numRead == 0 )
-            break;
+        CIPSTER_TRACE_ERR( "%s: error setting TCP_CORK: %s\n",
+            __func__, strerrno().c_str() );
+        return;
+    }
+
+    aSession->corked = aCork;
+#endif
+}
+
+
+/**
+ * Function flushTcpSession
+ * sends as much of the queued replies of a TCP session as the socket takes,
+ * then waits for writability only while some remain.  Past
+ * TCP_TX_QUEUE_LIMIT unsent bytes no more requests are read, so a client
+ * which does not read its replies gets backpressure instead of growing
+ * the queue.
+ *
+ * Sessions have TCP_NODELAY, so a lone reply goes out at once.  While more
+ * than one reply is queued the socket is corked, and what the socket takes
+ * of them over one or more wakeups leaves in full segments.  Uncorking when
+ * the queue drains sends the last partial segment.
+ */
+static EipStatus flushTcpSession( int socket, TcpSession* aSession )
+{
+    if( aSession->TxPending() )
+    {
+        if( aSession->tx_replies > 1 )
+            setTcpSessionCork( socket, aSession, true );
+
+        // one send() for all the replies queued in this wakeup
+        int sent_count = send( socket, &aSession->tx[aSession->tx_head],
+                            aSession->TxPending(), MSG_NOSIGNAL | MSG_DONTWAIT );
 
-        else if( numRead == -1 )
+        if( sent_count < 0 )
         {
-            i = -1;
-            break;
+            if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+            {
+                CIPSTER_TRACE_ERR( "%s: error on send: %s\n",
+                    __func__, strerrno().c_str() );
+                return kEipStatusError;
+            }
+        }
+        else
+        {
+            CIPSTER_TRACE_INFO( "%s: sent %d of %u reply bytes\n",
+                __func__, sent_count, aSession->TxPending() );
+
+            aSession->tx_head += sent_count;
+
+            if( !aSession->TxPending() )
+            {
+                aSession->tx.clear();
+                aSession->tx_head = 0;
+                aSession->tx_replies = 0;
+
+                setTcpSessionCork( socket, aSession, false );
+            }
+            else if( aSession->tx_head >= aSession->tx.size() / 2 )
+            {
+                // drop the sent front once it is the bigger part
+                aSession->tx.erase( aSession->tx.begin(),
+                                    aSession->tx.begin() + aSession->tx_head );
+                aSession->tx_head = 0;
+            }
         }
     }
 
-    return i;
+    // a full rx[] would have recv() asked for 0 bytes, which looks like EOF
+    setTcpSessionInterest( socket, aSession,
+        aSession->TxPending() < TCP_TX_QUEUE_LIMIT &&
+            aSession->rx_count < sizeof aSession->rx,
+        aSession->TxPending() > 0 );
+
+    return kEipStatusOk;
 }
 
 
-EipStatus HandleDataOnTcpSocket( int socket )
+/**
+ * Function handleTcpPackets
+ * hands each complete encapsulation packet in the session's rx buffer to
+ * the stack, in order, queueing the replies.  The start of a partial packet
+ * is kept for the next wakeup.
+ *
+ * @return bool - false if the session was closed while handling a packet.
+ */
+static bool handleTcpPackets( int socket, TcpSession* aSession )
 {
-    /* We will handle just one EIP packet here the rest is done by the select
-     * method which will inform us if more data is available in the socket
-     *  because of the current implementation of the main loop this may not be
-     *  the fastest way and a loop here with a non blocking socket would better
-     *  fit*/
+    unsigned pos = 0;
 
-    // Check how many bytes are here -- read the first four bytes from the connection
-    int num_read = ensuredRead( socket, s_packet, 4 );
+    for(;;)
+    {
+        unsigned avail = aSession->rx_count - pos;
 
-    // TODO we may have to set the socket to a non blocking socket
+        if( aSession->rx_discard )
+        {
+            unsigned skip = std::min( aSession->rx_discard, avail );
 
-    if( num_read == 0 )
-    {
-        CIPSTER_TRACE_ERR( "networkhandler: connection closed by client: %s\n",
-                strerrno().c_str() );
-        return kEipStatusError;
-    }
+            aSession->rx_discard -= skip;
+            pos += skip;
 
-    if( num_read < 0 )
-    {
-        CIPSTER_TRACE_ERR( "networkhandler: error on recv: %s\n", strerrno().c_str() );
-        return kEipStatusError;
-    }
+            if( aSession->rx_discard )
+                break;
 
-    BufReader rb( s_packet + 2, 2 );  // here is EIP's data length
+            continue;
+        }
 
-    unsigned packetz = rb.get16() + ENCAPSULATION_HEADER_LENGTH - 4;
-    // -4 is for the 4 bytes we have already read
+        // let the client read its replies before it gets more
+        if( aSession->TxPending() >= TCP_TX_QUEUE_LIMIT )
+            break;
 
-    // is the packet bigger than our s_packet buffer?
-    if( packetz > sizeof(s_packet) - 4 )
-    {
-        CIPSTER_TRACE_ERR(
-                "%s: packet len=%d is too big, ignoring packet\n",
-                __func__, packetz );
+        if( avail < 4 )
+            break;
 
-        // toss the whole packet in chunks.
+        BufReader rb( aSession->rx + pos + 2, 2 );  // here is EIP's data length
 
-        int readz = sizeof(s_packet);
+        unsigned packetz = rb.get16() + ENCAPSULATION_HEADER_LENGTH;
 
-        do {
-            num_read = ensuredRead( socket, &s_packet[0], readz );
+        // is the packet bigger than our buffer?
+        if( packetz > sizeof aSession->rx )
+        {
+            CIPSTER_TRACE_ERR(
+                    "%s: packet len=%d is too big, ignoring packet\n",
+                    __func__, packetz );
 
-            if( num_read == 0 ) // got error or connection closed by client
-            {
-                CIPSTER_TRACE_ERR( "networkhandler: connection closed by client: %s\n",
-                        strerrno().c_str() );
-                return kEipStatusError;
-            }
+            // toss the whole packet, over as many reads as it takes
+            aSession->rx_discard = packetz;
+            continue;
+        }
 
-            if( num_read < 0 )
-            {
-                CIPSTER_TRACE_ERR( "networkhandler: error on recv: %s\n",
-                        strerrno().c_str() );
-                return kEipStatusError;
-            }
+        if( avail < packetz )
+            break;
 
 #if defined(DEBUG)
-            dump( "bigTCP", s_packet, num_read );
+        dump( "rTCP", aSession->rx + pos, packetz );
 #endif
 
-            if( packetz != 0 && packetz < sizeof(s_packet) )
-            {
-                readz = packetz;
-            }
-        } while( packetz );
+        CIPSTER_TRACE_INFO( "Data received on tcp:\n" );
+
+        // serialize the reply straight into the transmit queue
+        unsigned tail = aSession->tx.size();
 
-        return kEipStatusOk;
+        aSession->tx.resize( tail + CIPSTER_ETHERNET_BUFFER_SIZE );
+
+        g_current_active_tcp_socket = socket;
+
+        int replyz = HandleReceivedExplictTcpData( socket,
+                            BufReader( aSession->rx + pos, packetz ),
+                            BufWriter( &aSession->tx[tail], CIPSTER_ETHERNET_BUFFER_SIZE ) );
+
+        g_current_active_tcp_socket = -1;
+
+        // the session may have been closed while handling the packet
+        if( socket >= (int) tcp_sessions.size() || tcp_sessions[socket] != aSession )
+            return false;
+
+        aSession->tx.resize( tail + std::max( replyz, 0 ) );
+
+        if( replyz > 0 )
+            ++aSession->tx_replies;
+
+        pos += packetz;
+
+        // a pipelined burst must not hold back the I/O which came due meanwhile
+        runDueConnectionTimers();
     }
 
-    num_read = ensuredRead( socket, &s_packet[4], packetz );
+    aSession->rx_count -= pos;
+    memmove( aSession->rx, aSession->rx + pos, aSession->rx_count );
+
+    return true;
+}
 
-    if( num_read == 0 ) // got error or connection closed by client
+
+/**
+ * Function heldTcpPacket
+ * tells if the session's rx buffer starts with a packet which
+ * handleTcpPackets() can act on without reading more, i.e. one held back
+ * by TCP_TX_QUEUE_LIMIT.
+ */
+static bool heldTcpPacket( TcpSession* aSession )
+{
+    if( aSession->rx_discard || aSession->rx_count < 4 )
+        return false;
+
+    BufReader rb( aSession->rx + 2, 2 );
+
+    unsigned packetz = rb.get16() + ENCAPSULATION_HEADER_LENGTH;
+
+    return packetz <= aSession->rx_count || packetz > sizeof aSession->rx;
+}
+
+
+/**
+ * Function serviceTcpSession
+ * handles the complete packets in the session's rx buffer and sends their
+ * replies.  Whenever a send brings the queue back under TCP_TX_QUEUE_LIMIT
+ * the requests held back are handled too, since nothing else would wake
+ * the session for them once it waits for readability only.
+ */
+static EipStatus serviceTcpSession( int socket, TcpSession* aSession )
+{
+    do
     {
-        CIPSTER_TRACE_ERR( "networkhandler: connection closed by client: %s\n",
-                strerrno().c_str() );
+        if( !handleTcpPackets( socket, aSession ) )
+            return kEipStatusOk;    // closed meanwhile
+
+        if( kEipStatusError == flushTcpSession( socket, aSession ) )
+            return kEipStatusError;
+
+    } while( aSession->TxPending() < TCP_TX_QUEUE_LIMIT && heldTcpPacket( aSession ) );
+
+    return kEipStatusOk;
+}
+
+
+EipStatus HandleDataOnTcpSocket( int socket )
+{
+    if( socket >= (int) tcp_sessions.size() || !tcp_sessions[socket] )
+    {
+        CIPSTER_TRACE_ERR( "%s: socket %d is not a TCP session\n", __func__, socket );
         return kEipStatusError;
     }
 
-    if( num_read < 0 )
+    TcpSession* session = tcp_sessions[socket];
+
+    // Held back packets fill rx[], handle them instead of reading.
+    if( session->rx_count == sizeof session->rx )
+        return serviceTcpSession( socket, session );
+
+    /*  The socket is non-blocking.  Take what is there, and if that fills
+        the buffer the socket stays readable for the next wakeup.
+    */
+    int num_read = recv( socket, session->rx + session->rx_count,
+                        sizeof session->rx - session->rx_count, 0 );
+
+    if( num_read == 0 )
     {
-        CIPSTER_TRACE_ERR( "networkhandler: error on recv: %s\n", strerrno().c_str() );
+        CIPSTER_TRACE_ERR( "networkhandler: connection closed by client\n" );
         return kEipStatusError;
     }
 
-    if( (unsigned) num_read == packetz )
+    if( num_read < 0 )
     {
-        // we got the right amount of data
-        packetz += 4;
-
-#if defined(DEBUG)
-        dump( "rTCP", s_packet, num_read + 4 );
-#endif
+        if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+            return kEipStatusOk;
 
-        // TODO handle partial packets
-        CIPSTER_TRACE_INFO( "Data received on tcp:\n" );
+        CIPSTER_TRACE_ERR( "networkhandler: error on recv: %s\n", strerrno().c_str() );
+        return kEipStatusError;
+    }
 
-        g_current_active_tcp_socket = socket;
+    session->rx_count += num_read;
 
-        int replyz = HandleReceivedExplictTcpData( socket,
-                            BufReader( s_packet, packetz ),
-                            BufWriter( s_packet, sizeof s_packet ) );
+    return serviceTcpSession( socket, session );
+}
 
-        g_current_active_tcp_socket = -1;
 
-        if( replyz > 0 )
-        {
-            int sent_count = send( socket, (char*) s_packet, replyz, 0 );
+/**
+ * Function handleWritableTcpSocket
+ * continues sending the queued replies of a TCP session, and once the queue
+ * is short enough again handles the requests held back meanwhile.
+ */
+static EipStatus handleWritableTcpSocket( int socket )
+{
+    if( socket >= (int) tcp_sessions.size() || !tcp_sessions[socket] )
+        return kEipStatusOk;    // closed earlier in this pass
 
-            CIPSTER_TRACE_INFO( "%s: sent %d reply bytes. line %d\n",
-                __func__, sent_count, __LINE__ );
+    TcpSession* session = tcp_sessions[socket];
 
-            if( sent_count != replyz )
-            {
-                CIPSTER_TRACE_WARN( "%s: TCP response was not fully sent\n", __func__ );
-            }
-        }
+    if( kEipStatusError == flushTcpSession( socket, session ) )
+        return kEipStatusError;
 
-        return kEipStatusOk;
-    }
-    else
-    {
-        /* we got a fragmented packet currently we cannot handle this will
-         * for this we would need a network buffer per TCP socket
-         *
-         * However with typical packet sizes of EIP this should't be a big issue.
-         */
-        //TODO handle fragmented packets
-
-        CIPSTER_TRACE_ERR( "%s: TCP read problem\n", __func__ );
-    }
+    if( session->TxPending() < TCP_TX_QUEUE_LIMIT && heldTcpPacket( session ) )
+        return serviceTcpSession( socket, session );
 
-    return kEipStatusError;
+    return kEipStatusOk;
 }
 
 
@@ -720,12 +1540,10 @@ int CreateUdpSocket( UdpCommuncationDirection communication_direction,
         socket_data->sin_addr.s_addr = peer_address.sin_addr.s_addr;
     }
 
-    // add new socket to the master list
-    FD_SET( new_socket, &master_set );
-
-    if( new_socket > highest_socket_handle )
+    // only a consuming socket receives, a producing socket need not be watched
+    if( communication_direction == kUdpConsuming )
     {
-        highest_socket_handle = new_socket;
+        watchSocket( new_socket, kSocketUdpConsuming );
     }
 
     return new_socket;
@@ -750,7 +1568,13 @@ void CloseSocket( int socket_handle )
 
     if( socket_handle >= 0 )
     {
-        FD_CLR( socket_handle, &master_set );
+        if( socket_handle < (int) tcp_sessions.size() )
+        {
+            delete tcp_sessions[socket_handle];
+            tcp_sessions[socket_handle] = NULL;
+        }
+
+        unwatchSocket( socket_handle );
         shutdown( socket_handle, SHUT_RDWR );
         close( socket_handle );
     }
@@ -775,15 +1599,30 @@ void CheckAndHandleTcpListenerSocket()
             return;
         }
 
-        FD_SET( new_socket, &master_set );
-
-        // add newfd to master set
-        if( new_socket > highest_socket_handle )
+        // a slow or stalled client must not block the whole stack
+        if( fcntl( new_socket, F_SETFL, fcntl( new_socket, F_GETFL ) | O_NONBLOCK ) == -1 )
         {
-            highest_socket_handle = new_socket;
+            CIPSTER_TRACE_ERR( "networkhandler: error on fcntl: %s\n",
+                    strerrno().c_str() );
+            close( new_socket );
+            return;
         }
 
-        CIPSTER_TRACE_INFO( "%s: adding TCP socket %d to master_set\n",
+        // replies are coalesced in the transmit queue, so Nagle would only
+        // hold back the last segment of a burst until the client's ACK.
+        // Longer backlogs are corked instead, see flushTcpSession().
+        static const int one = 1;
+
+        setsockopt( new_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one );
+
+        if( new_socket >= (int) tcp_sessions.size() )
+            tcp_sessions.resize( new_socket + 1 );
+
+        tcp_sessions[new_socket] = new TcpSession();
+
+        watchSocket( new_socket, kSocketTcpSession );
+
+        CIPSTER_TRACE_INFO( "%s: adding TCP socket %d to watched set\n",
             __func__, new_socket );
     }
 }
@@ -968,50 +1807,172 @@ void CheckAndHandleUdpUnicastSocket()
 }
 
 
-void CheckAndHandleConsumingUdpSockets()
-{
-    struct sockaddr_in from_address;
+#if CIPSTER_USE_RECVMMSG
 
-    socklen_t from_address_length;
+static void handleConsumingUdpSocket( CipConn* aConn )
+{
+    int socket = aConn->consuming_socket;
+    int received_count;
 
-    CipConn* iter = g_active_connection_list;
+    // grows as Forward Opens negotiate larger connections
+    if( batch_stride <= ConsumedPacketSizeMax() )
+    {
+        batch_stride = ConsumedPacketSizeMax() + 1;
+        batch_packets.resize( UDP_RECV_BATCH_SIZE * batch_stride );
+    }
 
-    // see a message on one of the registered UDP sockets has been received
-    while( iter )
+    // drain the socket, a full batch means there may be more
+    do
     {
-        CipConn* conn = iter;
+        for( int i = 0; i < UDP_RECV_BATCH_SIZE;  ++i )
+        {
+            batch_iov[i].iov_base = &batch_packets[i * batch_stride];
+            batch_iov[i].iov_len  = batch_stride;
 
-        // do this at the beginning as the close function can make the entry invalid
-        iter = iter->next;
+            msghdr& hdr = batch_msgs[i].msg_hdr;
 
-        if( conn->consuming_socket != -1  &&  CheckSocketSet( conn->consuming_socket ) )
+            memset( &hdr, 0, sizeof hdr );
+            hdr.msg_name    = &batch_from[i];
+            hdr.msg_namelen = sizeof batch_from[i];
+            hdr.msg_iov     = &batch_iov[i];
+            hdr.msg_iovlen  = 1;
+        }
+
+        received_count = recvmmsg( socket, batch_msgs, UDP_RECV_BATCH_SIZE,
+                            MSG_DONTWAIT, NULL );
+
+        if( received_count < 0 )
         {
-            from_address_length = sizeof(from_address);
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+                break;      // drained
 
-            int received_size = recvfrom(
-                    conn->consuming_socket,
-                    s_packet, sizeof(s_packet), 0,
-                    (struct sockaddr*) &from_address, &from_address_length );
+            CIPSTER_TRACE_ERR( "%s: error on recvmmsg: %s\n",
+                    __func__, strerrno().c_str() );
 
-            if( 0 == received_size )
+            aConn->connection_close_function( aConn );
+            return;
+        }
+
+        ++recv_batch_stats.calls;
+        recv_batch_stats.packets += received_count;
+        ++recv_batch_stats.histogram[received_count];
+
+        if( (unsigned) received_count > recv_batch_stats.max_batch )
+            recv_batch_stats.max_batch = received_count;
+
+        for( int i = 0; i < received_count;  ++i )
+        {
+            if( 0 == batch_msgs[i].msg_len )
             {
                 CIPSTER_TRACE_STATE( "connection closed by client\n" );
-                conn->connection_close_function(
-                        conn );
-                continue;
+                aConn->connection_close_function( aConn );
+                return;
             }
 
-            if( 0 > received_size )
+            if( batch_msgs[i].msg_len >= (unsigned) batch_stride )
             {
-                CIPSTER_TRACE_ERR( "%s: error on recv: %s\n",
-                        __func__, strerrno().c_str() );
-
-                conn->connection_close_function( conn );
+                CIPSTER_TRACE_WARN( "%s: dropped a packet longer than any connection's\n",
+                        __func__ );
                 continue;
             }
 
-            HandleReceivedConnectedData( &from_address,
-                BufReader( s_packet, received_size ) );
+            HandleReceivedConnectedData( &batch_from[i],
+                BufReader( &batch_packets[i * batch_stride], batch_msgs[i].msg_len ) );
+
+            // a packet may have caused the connection to be closed.
+            if( aConn->consuming_socket != socket )
+                return;
+        }
+
+    } while( received_count == UDP_RECV_BATCH_SIZE );
+}
+
+
+void NetworkHandlerShowStats()
+{
+    const RecvBatchStats& st = recv_batch_stats;
+
+    printf( "class 0/1 recvmmsg() batches, max size %d:\n", UDP_RECV_BATCH_SIZE );
+    printf( " calls:%u  packets:%u  average:%.2f  max:%u\n",
+        st.calls, st.packets,
+        st.calls ? double( st.packets ) / st.calls : 0.0,
+        st.max_batch );
+
+    for( int i = 1; i <= UDP_RECV_BATCH_SIZE;  ++i )
+    {
+        if( st.histogram[i] )
+            printf( " %2d packets: %u calls\n", i, st.histogram[i] );
+    }
+}
+
+#else
+
+/// Where a class 0/1 packet is received, large enough for the largest
+/// connection size negotiated so far and a byte more, by which a longer
+/// packet is told.
+static std::vector<EipByte> s_io_packet;
+
+
+static void handleConsumingUdpSocket( CipConn* aConn )
+{
+    struct sockaddr_in from_address;
+
+    socklen_t from_address_length = sizeof(from_address);
+
+    if( (int) s_io_packet.size() <= ConsumedPacketSizeMax() )
+        s_io_packet.resize( ConsumedPacketSizeMax() + 1 );
+
+    // a longer datagram is cut to the buffer's size
+    int received_size = recvfrom(
+            aConn->consuming_socket,
+            &s_io_packet[0], s_io_packet.size(), 0,
+            (struct sockaddr*) &from_address, &from_address_length );
+
+    if( 0 == received_size )
+    {
+        CIPSTER_TRACE_STATE( "connection closed by client\n" );
+        aConn->connection_close_function( aConn );
+        return;
+    }
+
+    if( 0 > received_size )
+    {
+        CIPSTER_TRACE_ERR( "%s: error on recv: %s\n",
+                __func__, strerrno().c_str() );
+
+        aConn->connection_close_function( aConn );
+        return;
+    }
+
+    if( received_size >= (int) s_io_packet.size() )
+    {
+        CIPSTER_TRACE_WARN( "%s: dropped a packet longer than any connection's\n",
+                __func__ );
+        return;
+    }
+
+    HandleReceivedConnectedData( &from_address,
+        BufReader( &s_io_packet[0], received_size ) );
+}
+
+#endif
+
+
+void CheckAndHandleConsumingUdpSockets()
+{
+    CipConn* iter = g_active_connection_list;
+
+    // see a message on one of the registered UDP sockets has been received
+    while( iter )
+    {
+        CipConn* conn = iter;
+
+        // do this at the beginning as the close function can make the entry invalid
+        iter = iter->next;
+
+        if( conn->consuming_socket != -1  &&  CheckSocketSet( conn->consuming_socket ) )
+        {
+            handleConsumingUdpSocket( conn );
         }
     }
 }
@@ -20,4 +20,12 @@ EipStatus NetworkHandlerProcessOnce();
 
 EipStatus NetworkHandlerFinish();
 
+#if CIPSTER_USE_RECVMMSG
+/**
+ * Function NetworkHandlerShowStats
+ * prints to stdout how many class 0/1 packets each recvmmsg() call returned.
+ */
+void NetworkHandlerShowStats();
+#endif
+
 #endif // CIPSTER_NETWORKHANDLER_H_
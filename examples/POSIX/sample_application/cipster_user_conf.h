@@ -39,6 +39,12 @@
  */
 #define CIPSTER_CIP_NUM_EXPLICIT_CONNS 6
 
+/** @brief Number of request paths each explicit connection remembers the
+ *  resolved class, instance and service of, so that repeated class 3
+ *  requests skip parsing and lookup.  0 to disable.
+ */
+#define CIPSTER_REQUEST_PATH_CACHE_SIZE 4
+
 /** @brief Define the number of supported exclusive owner connections.
  *  Each of these connections has to be configured with the function
  *  void configureExclusiveOwnerConnectionPoint(unsigned pa_unConnNum, unsigned pa_unOutputAssembly, unsigned pa_unInputAssembly, unsigned pa_unConfigAssembly)
@@ -83,14 +89,50 @@
  */
 #define CIPSTER_ETHERNET_BUFFER_SIZE            1200
 
+/**
+ * The largest class 0/1 payload in bytes, not counting the sequence count and
+ * run/idle header, that OpenIO() accepts.  A Large Forward Open may ask for up
+ * to 4000, which wants jumbo frames to avoid IP fragmentation.  The network
+ * handler sizes its class 0/1 receive buffers from this.
+ */
+#define CIPSTER_IO_DATA_SIZE_MAX                4000
+
+/**
+ * The number of I/O connections whose produced data is collected in one timer
+ * tick and then handed to SendUdpDataBatch() together.  Each uses a buffer
+ * for the packet header, the payload is sent from the assembly.
+ */
+#define CIPSTER_PRODUCTION_BATCH_SIZE           32
+
+/** @brief Number of records in the ring through which the stack hands I/O
+ * data, I/O connection and run/idle events to the application, see
+ * PopCipsterEvent().  A power of 2, or 0 to call the application's
+ * callbacks directly instead.  May be given on the command line, see the
+ * CIPster_EVENT_RING_SIZE CMake setting.
+ */
+#ifndef CIPSTER_EVENT_RING_SIZE
+#define CIPSTER_EVENT_RING_SIZE                 0
+#endif
+
 /** @brief Number of sessions that can be handled at the same time
  */
 #define CIPSTER_NUMBER_OF_SUPPORTED_SESSIONS 20
 
+/** @brief Number of delayed replies to broadcast ListIdentity requests that
+ * can be pending at the same time, at least 2 per the EIP spec.  A repeated
+ * request from a tool already waiting for its reply does not add another.
+ */
+#define CIPSTER_DELAYED_LIST_IDENTITY_MAX    64
+
 /** @brief  The time in usecs of the timer used in this implementations
  */
 static const unsigned kOpenerTimerTickInMicroSeconds = 10000;
 
+/** @brief The smallest T->O RPI in usecs granted when the connection timers
+ * are driven by ManageConnectionTimers() instead of the timer tick
+ */
+static const unsigned kOpenerMinRpiInMicroSeconds = 250;
+
 /** @brief Define if RUN IDLE data is sent with consumed data
  */
 static const int kOpenerConsumedDataHasRunIdleHeader = 1;
@@ -22,6 +22,11 @@ EipUint8    g_assembly_data096[128];    // Output
 EipUint8    g_assembly_data097[64];     // Config
 EipUint8    g_assembly_data09A[128];    // Explicit
 
+// tags for the Read Tag and Write Tag services
+CipDint     g_tag_counter;
+CipReal     g_tag_recipe[500];
+CipInt      g_tag_matrix[4][8];
+
 
 EipStatus ApplicationInitialization()
 {
@@ -73,6 +78,10 @@ EipStatus ApplicationInitialization()
             DEMO_APP_INPUT_ASSEMBLY_NUM,
             DEMO_APP_CONFIG_ASSEMBLY_NUM );
 
+    CreateSymbolInstance( "Counter", kCipDint, &g_tag_counter );
+    CreateSymbolInstance( "Recipe", kCipReal, g_tag_recipe, DIM( g_tag_recipe ) );
+    CreateSymbolInstance( "Matrix", kCipInt, g_tag_matrix, 4, 8 );
+
     return kEipStatusOk;
 }
 
@@ -80,6 +89,31 @@ EipStatus ApplicationInitialization()
 void HandleApplication()
 {
     // check if application needs to trigger an connection
+
+    // With CIPSTER_EVENT_RING_SIZE the stack queues what it would otherwise
+    // tell the callbacks below.  A multi-threaded application would drain
+    // the ring on its own thread, this one does it on the stack's.
+    CipsterEvent event;
+
+    while( PopCipsterEvent( &event ) )
+    {
+        switch( event.type )
+        {
+        case kCipsterEventAssemblyDataReceived:
+            AfterAssemblyDataReceived(
+                GetCipClass( kCipAssemblyClassCode )->Instance( event.instance_id ) );
+            break;
+
+        case kCipsterEventIoConnection:
+            CheckIoConnectionEvent( event.instance_id, event.value,
+                    (IoConnectionEvent) event.io_event );
+            break;
+
+        case kCipsterEventRunIdleChanged:
+            RunIdleChanged( event.value );
+            break;
+        }
+    }
 }
 
 
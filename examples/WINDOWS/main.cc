@@ -76,6 +76,9 @@ int main( int argc, char* argv[] )
         goto shutdown;
     }
 
+    // Route explicit requests by table lookups from here on
+    FreezeCipDispatch();
+
     // Setup Network Handles
     if( NetworkHandlerInitialize() != kEipStatusOk )
     {
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <vector>
 
  #include <winsock2.h>
  #include <windows.h>
@@ -32,6 +33,10 @@ extern CipConn* g_active_connection_list;
  */
 static EipByte s_packet[CIPSTER_ETHERNET_BUFFER_SIZE];
 
+/// Where a class 0/1 packet is received, large enough for the largest
+/// connection size negotiated so far.
+static std::vector<EipByte> s_io_packet;
+
 
 #define MAX_NO_OF_TCP_SOCKETS           10
 
@@ -487,6 +492,36 @@ EipStatus SendUdpData( struct sockaddr_in* address, int socket, BufReader aOutpu
 }
 
 
+void SendUdpDataBatch( UdpSendItem* aItems, int aCount )
+{
+    for( int i = 0; i < aCount;  ++i )
+    {
+        UdpSendItem&    item = aItems[i];
+        WSABUF          bufs[2];
+        DWORD           sent_count;
+
+        bufs[0].buf = (char*) item.header.data();
+        bufs[0].len = item.header.size();
+        bufs[1].buf = (char*) item.data.data();
+        bufs[1].len = item.data.size();
+
+        if( WSASendTo( item.socket, bufs, DIM( bufs ), &sent_count, 0,
+                (struct sockaddr*) item.address, sizeof *item.address, NULL, NULL ) )
+        {
+            CIPSTER_TRACE_ERR( "%s: error with WSASendTo: %s\n",
+                    __func__, strerrno().c_str() );
+
+            item.result = kEipStatusError;
+        }
+        else
+        {
+            item.result = sent_count == bufs[0].len + bufs[1].len ?
+                            kEipStatusOk : kEipStatusError;
+        }
+    }
+}
+
+
 #if defined(DEBUG)
 static void dump( const char* aPrompt, EipByte* aBytes, int aCount )
 {
@@ -1027,9 +1062,12 @@ void CheckAndHandleConsumingUdpSockets()
         {
             from_address_length = sizeof(from_address);
 
+            if( (int) s_io_packet.size() < ConsumedPacketSizeMax() )
+                s_io_packet.resize( ConsumedPacketSizeMax() );
+
             int received_size = recvfrom(
                     conn->consuming_socket,
-                    (char*) s_packet, sizeof(s_packet), 0,
+                    (char*) &s_io_packet[0], s_io_packet.size(), 0,
                     (struct sockaddr*) &from_address, &from_address_length );
 
             if( 0 == received_size )
@@ -1042,6 +1080,14 @@ void CheckAndHandleConsumingUdpSockets()
 
             if( 0 > received_size )
             {
+                // a packet longer than any connection's is dropped
+                if( WSAGetLastError() == WSAEMSGSIZE )
+                {
+                    CIPSTER_TRACE_WARN( "%s: dropped a packet longer than any connection's\n",
+                            __func__ );
+                    continue;
+                }
+
                 CIPSTER_TRACE_ERR( "%s: error on recv: %s\n",
                         __func__, strerrno().c_str() );
 
@@ -1050,7 +1096,7 @@ void CheckAndHandleConsumingUdpSockets()
             }
 
             HandleReceivedConnectedData( &from_address,
-                BufReader( s_packet, received_size ) );
+                BufReader( &s_io_packet[0], received_size ) );
         }
     }
 }
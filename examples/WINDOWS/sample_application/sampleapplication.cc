@@ -22,6 +22,11 @@ EipUint8    g_assembly_data096[128];    // Output
 EipUint8    g_assembly_data097[64];     // Config
 EipUint8    g_assembly_data09A[128];    // Explicit
 
+// tags for the Read Tag and Write Tag services
+CipDint     g_tag_counter;
+CipReal     g_tag_recipe[500];
+CipInt      g_tag_matrix[4][8];
+
 
 EipStatus ApplicationInitialization()
 {
@@ -71,6 +76,10 @@ EipStatus ApplicationInitialization()
             DEMO_APP_INPUT_ASSEMBLY_NUM,
             DEMO_APP_CONFIG_ASSEMBLY_NUM );
 
+    CreateSymbolInstance( "Counter", kCipDint, &g_tag_counter );
+    CreateSymbolInstance( "Recipe", kCipReal, g_tag_recipe, DIM( g_tag_recipe ) );
+    CreateSymbolInstance( "Matrix", kCipInt, g_tag_matrix, 4, 8 );
+
     return kEipStatusOk;
 }
 
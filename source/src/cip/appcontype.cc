@@ -8,6 +8,7 @@
 
 #include "appcontype.h"
 #include "cipconnectionmanager.h"
+#include "cipevents.h"
 
 struct ExclusiveOwnerConnection
 {
@@ -344,7 +345,7 @@ void CloseAllConnectionsForInputWithSameType( EipUint32 input_point,  ConnInstan
             connection_to_delete = connection;
             connection = connection->next;
 
-            CheckIoConnectionEvent(
+            NotifyIoConnectionEvent(
                     connection_to_delete->conn_path.consuming_path.GetInstanceOrConnPt(),
                     connection_to_delete->conn_path.producing_path.GetInstanceOrConnPt(),
                     kIoConnectionEventClosed );
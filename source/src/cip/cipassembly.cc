@@ -12,6 +12,7 @@
 //#include "cipster_api.h"
 #include "trace.h"
 #include "cipconnectionmanager.h"
+#include "cipevents.h"
 
 
 // getter and setter of type AssemblyFunc, specific to this CIP class called "Assembly"
@@ -21,6 +22,8 @@ static EipStatus getAttrAssemblyData( CipAttribute* attr,
 {
     if( attr->data )
     {
+        static_cast<AssemblyInstance*>( attr->Instance() )->RefreshSnapshot();
+
         BeforeAssemblyDataSend( attr->Instance() );
 
         return GetAttrData( attr, request, response );
@@ -62,7 +65,7 @@ static EipStatus setAttrAssemblyData( CipAttribute* attr,
                 instance->Id()
                 );
 
-            memcpy( byte_array->data, request->data.data(), byte_array->length );
+            static_cast<AssemblyInstance*>( instance )->StoreData( request->data );
 
             if( AfterAssemblyDataReceived( instance ) != kEipStatusOk )
             {
@@ -92,8 +95,27 @@ static EipStatus setAttrAssemblyData( CipAttribute* attr,
 }
 
 
+AssemblySnapshots::AssemblySnapshots( int aByteCount ) :
+    back( 0 ),
+    front( 2 ),
+    middle( 1 )
+{
+    buf[0] = new EipByte[3 * aByteCount]();
+    buf[1] = buf[0] + aByteCount;
+    buf[2] = buf[1] + aByteCount;
+}
+
+
+AssemblySnapshots::~AssemblySnapshots()
+{
+    delete[] buf[0];
+}
+
+
 AssemblyInstance::AssemblyInstance( int aInstanceId, BufWriter aBuffer ) :
-    CipInstance( aInstanceId )
+    CipInstance( aInstanceId ),
+    snapshots( NULL ),
+    writer( kAssemblyWrittenByApplication )
 {
     byte_array.length = aBuffer.size();
     byte_array.data   = aBuffer.data();
@@ -106,14 +128,51 @@ AssemblyInstance::AssemblyInstance( int aInstanceId, BufWriter aBuffer ) :
 }
 
 
-CipInstance* CreateAssemblyInstance( int instance_id, BufWriter aBuffer )
+AssemblyInstance::AssemblyInstance( int aInstanceId, int aByteCount,
+        AssemblySnapshotWriter aWriter ) :
+    CipInstance( aInstanceId ),
+    snapshots( new AssemblySnapshots( aByteCount ) ),
+    writer( aWriter )
+{
+    byte_array.length = aByteCount;
+
+    // the stack reads the application's front image, or its own last published one
+    byte_array.data = aWriter == kAssemblyWrittenByApplication ?
+                        snapshots->Front() : snapshots->Back();
+
+    AttributeInsert( 3, kCipByteArray, kSetAndGetAble, getAttrAssemblyData, setAttrAssemblyData, &byte_array );
+    AttributeInsert( 4, kCipUint, kGetableSingle, &byte_array.length );
+}
+
+
+AssemblyInstance::~AssemblyInstance()
+{
+    delete snapshots;
+}
+
+
+void AssemblyInstance::StoreData( BufReader aInput )
+{
+    if( snapshots && writer == kAssemblyWrittenByStack )
+    {
+        memcpy( snapshots->Back(), aInput.data(), byte_array.length );
+
+        // the published buffer stays unchanged until the stack's next Publish()
+        byte_array.data = snapshots->Publish();
+    }
+    else
+    {
+        memcpy( byte_array.data, aInput.data(), byte_array.length );
+    }
+}
+
+
+static CipInstance* insertAssemblyInstance( AssemblyInstance* i )
 {
     CipClass* clazz = GetCipClass( kCipAssemblyClassCode );
 
     CIPSTER_ASSERT( clazz ); // Stack startup should have called CipAssemblyInitialize()
 
-    AssemblyInstance* i = new AssemblyInstance( instance_id, aBuffer );
-
     if( !clazz->InstanceInsert( i ) )
     {
         delete i;
@@ -121,13 +180,58 @@ CipInstance* CreateAssemblyInstance( int instance_id, BufWriter aBuffer )
     }
     else
     {
-        CIPSTER_TRACE_INFO( "%s: created assembly instance_id %d\n", __func__, instance_id );
+        CIPSTER_TRACE_INFO( "%s: created assembly instance_id %d\n", __func__, i->Id() );
     }
 
     return i;
 }
 
 
+CipInstance* CreateAssemblyInstance( int instance_id, BufWriter aBuffer )
+{
+    return insertAssemblyInstance( new AssemblyInstance( instance_id, aBuffer ) );
+}
+
+
+CipInstance* CreateSnapshotAssemblyInstance( int instance_id, int aByteCount,
+        AssemblySnapshotWriter aWriter )
+{
+    return insertAssemblyInstance( new AssemblyInstance( instance_id, aByteCount, aWriter ) );
+}
+
+
+EipByte* AssemblyWriteBuffer( CipInstance* aInstance )
+{
+    AssemblyInstance* assembly = static_cast<AssemblyInstance*>( aInstance );
+
+    CIPSTER_ASSERT( assembly->snapshots && assembly->writer == kAssemblyWrittenByApplication );
+
+    return assembly->snapshots->Back();
+}
+
+
+void AssemblyPublish( CipInstance* aInstance )
+{
+    AssemblyInstance* assembly = static_cast<AssemblyInstance*>( aInstance );
+
+    CIPSTER_ASSERT( assembly->snapshots && assembly->writer == kAssemblyWrittenByApplication );
+
+    assembly->snapshots->Publish();
+}
+
+
+const EipByte* AssemblyLatestData( CipInstance* aInstance )
+{
+    AssemblyInstance* assembly = static_cast<AssemblyInstance*>( aInstance );
+
+    CIPSTER_ASSERT( assembly->snapshots && assembly->writer == kAssemblyWrittenByStack );
+
+    assembly->snapshots->Acquire();
+
+    return assembly->snapshots->Front();
+}
+
+
 class CipAssemblyClass : public CipClass
 {
 public:
@@ -166,7 +270,11 @@ EipStatus CipAssemblyInitialize()
 }
 
 
-EipStatus NotifyAssemblyConnectedDataReceived( CipInstance* instance, BufReader aBuffer )
+/**
+ * Function storeConnectedData
+ * copies data received on a connection into the assembly's attribute 3.
+ */
+static EipStatus storeConnectedData( CipInstance* instance, BufReader aBuffer )
 {
     CIPSTER_ASSERT( instance->owning_class->ClassId() == kCipAssemblyClassCode );
 
@@ -189,10 +297,28 @@ EipStatus NotifyAssemblyConnectedDataReceived( CipInstance* instance, BufReader
     }
     else
     {
-        memcpy( byte_array->data, aBuffer.data(), aBuffer.size() );
+        static_cast<AssemblyInstance*>( instance )->StoreData( aBuffer );
     }
 
+    return kEipStatusOk;
+}
+
+
+EipStatus NotifyAssemblyConnectedDataReceived( CipInstance* instance, BufReader aBuffer )
+{
+    if( storeConnectedData( instance, aBuffer ) != kEipStatusOk )
+        return kEipStatusError;
+
     // notify application that new data arrived
+    return NotifyAssemblyDataReceived( instance );
+}
+
+
+EipStatus NotifyAssemblyConfigDataReceived( CipInstance* instance, BufReader aBuffer )
+{
+    if( storeConnectedData( instance, aBuffer ) != kEipStatusOk )
+        return kEipStatusError;
+
     return AfterAssemblyDataReceived( instance );
 }
 
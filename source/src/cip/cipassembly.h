@@ -6,8 +6,71 @@
 #ifndef CIPSTER_CIPASSEMBLY_H_
 #define CIPSTER_CIPASSEMBLY_H_
 
+#include <atomic>
+
 #include "typedefs.h"
 #include "ciptypes.h"
+#include "cipster_api.h"
+
+
+/**
+ * Class AssemblySnapshots
+ * is a triple buffer with one writer and one reader on different threads.
+ * The writer fills Back() and publishes it with an atomic swap against the
+ * middle buffer, the reader swaps a fresh middle buffer against its front
+ * one.  So each side owns one buffer at any time and neither ever waits.
+ */
+class AssemblySnapshots
+{
+public:
+    AssemblySnapshots( int aByteCount );
+    ~AssemblySnapshots();
+
+    /// Function Back returns the buffer the writer fills next.
+    EipByte* Back() const               { return buf[back]; }
+
+    /// Function Front returns the image the reader picked up last.
+    EipByte* Front() const              { return buf[front]; }
+
+    /**
+     * Function Publish
+     * makes the filled Back() the newest image, writer side.
+     * @return EipByte* - the published buffer.
+     */
+    EipByte* Publish()
+    {
+        unsigned published = back;
+
+        back = middle.exchange( back | kFresh, std::memory_order_acq_rel ) & kIndexMask;
+        return buf[published];
+    }
+
+    /**
+     * Function Acquire
+     * picks up the newest published image, if any, as Front(), reader side.
+     * @return bool - true if Front() changed.
+     */
+    bool Acquire()
+    {
+        if( !( middle.load( std::memory_order_relaxed ) & kFresh ) )
+            return false;
+
+        front = middle.exchange( front, std::memory_order_acq_rel ) & kIndexMask;
+        return true;
+    }
+
+private:
+    enum
+    {
+        kIndexMask  = 3,
+        kFresh      = 4,        ///< middle was published since the reader took it
+    };
+
+    EipByte*    buf[3];
+    unsigned    back;           ///< owned by the writer
+    unsigned    front;          ///< owned by the reader
+    std::atomic<unsigned> middle;
+};
 
 
 /**
@@ -15,15 +78,45 @@
  * is extended from CipInstance with an extra CipByteArray at the end.
  * That byte array has no ownership of the low level array, which for an
  * assembly is owned by the application program and passed into
- * CreateAssemblyInstance().
+ * CreateAssemblyInstance().  For an assembly created by
+ * CreateSnapshotAssemblyInstance() it points at the stack's side of the
+ * triple buffer instead.
  */
 class AssemblyInstance : public CipInstance
 {
 public:
     AssemblyInstance( int aInstanceId, BufWriter aBuf );
+    AssemblyInstance( int aInstanceId, int aByteCount, AssemblySnapshotWriter aWriter );
+    ~AssemblyInstance();
+
+    /**
+     * Function RefreshSnapshot
+     * points byte_array at the newest image published by the application,
+     * before the stack reads the data.
+     * @return bool - true if the image is new since the last call.
+     */
+    bool RefreshSnapshot()
+    {
+        if( !snapshots || writer != kAssemblyWrittenByApplication ||
+            !snapshots->Acquire() )
+            return false;
+
+        byte_array.data = snapshots->Front();
+        return true;
+    }
+
+    /**
+     * Function StoreData
+     * replaces the assembly data with @a aInput, of byte_array.length bytes.
+     * For a snapshot assembly that is a complete new image for the application.
+     */
+    void StoreData( BufReader aInput );
 
 //protected:
     CipByteArray    byte_array;
+
+    AssemblySnapshots*      snapshots;  ///< NULL unless a snapshot assembly
+    AssemblySnapshotWriter  writer;
 };
 
 
@@ -51,4 +144,12 @@ EipStatus CipAssemblyInitialize();
  */
 EipStatus NotifyAssemblyConnectedDataReceived( CipInstance* aInstance, BufReader aInput );
 
+/** @brief notify an Assembly object that configuration data has been received for it.
+ *
+ *  Like NotifyAssemblyConnectedDataReceived(), but the application is always
+ *  asked with AfterAssemblyDataReceived(), also with the event ring, since
+ *  the Forward Open's reply depends on its verdict.
+ */
+EipStatus NotifyAssemblyConfigDataReceived( CipInstance* aInstance, BufReader aInput );
+
 #endif // CIPSTER_CIPASSEMBLY_H_
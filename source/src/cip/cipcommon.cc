@@ -4,6 +4,8 @@
  *
  ******************************************************************************/
 #include <string.h>
+#include <algorithm>
+#include <stdexcept>
 
 #include "cipcommon.h"
 
@@ -19,6 +21,7 @@
 #include "ciperror.h"
 #include "cipassembly.h"
 #include "cipmessagerouter.h"
+#include "ciptypedattribute.h"
 #include "cpf.h"
 #include "appcontype.h"
 
@@ -209,7 +212,9 @@ EipStatus GetInstanceCount( CipAttribute* attr, CipMessageRouterRequest* request
 CipInstance::CipInstance( int aInstanceId ) :
     instance_id( aInstanceId ),
     owning_class( 0 ),           // NULL (not owned) until I am inserted into a CipClass
-    highest_inst_attr_id( 0 )
+    highest_inst_attr_id( 0 ),
+    get_all_cacheable( false ),
+    get_all_cached( false )
 {
 }
 
@@ -274,10 +279,25 @@ bool CipInstance::AttributeInsert( CipAttribute* aAttribute )
             owning_class->highest_attr_id = highest_inst_attr_id;
     }
 
+    if( attribute_index.Frozen() )
+        indexAttributes();
+
+    InvalidateAttributeAll();
+
     return true;
 }
 
 
+void CipInstance::indexAttributes()
+{
+    if( attribute_index.Index( highest_inst_attr_id, attributes.size(), 64 ) )
+    {
+        for( CipAttributes::const_iterator it = attributes.begin(); it != attributes.end(); ++it )
+            attribute_index.Put( (*it)->Id(), *it );
+    }
+}
+
+
 CipAttribute* CipInstance::AttributeInsert(
         int             attribute_id,
         EipUint8        cip_type,
@@ -334,13 +354,23 @@ CipAttribute* CipInstance::AttributeInsert(
 
 CipAttribute* CipInstance::Attribute( int aAttributeId ) const
 {
-    CipAttributes::const_iterator  it;
+    if( attribute_index.Indexed() )
+    {
+        CipAttribute* attribute = attribute_index.Find( aAttributeId );
 
-    // a binary search thru the vector of pointers looking for aAttributeId
-    it = vec_search( attributes.begin(), attributes.end(), aAttributeId );
+        if( attribute )
+            return attribute;
+    }
+    else
+    {
+        CipAttributes::const_iterator  it;
 
-    if( it != attributes.end() )
-        return *it;
+        // a binary search thru the vector of pointers looking for aAttributeId
+        it = vec_search( attributes.begin(), attributes.end(), aAttributeId );
+
+        if( it != attributes.end() )
+            return *it;
+    }
 
     CIPSTER_TRACE_WARN( "attribute %d not defined\n", aAttributeId );
 
@@ -350,6 +380,9 @@ CipAttribute* CipInstance::Attribute( int aAttributeId ) const
 
 //-----<CipClass>--------------------------------------------------------------
 
+unsigned CipClass::dispatch_generation;
+
+
 CipClass::CipClass(
         EipUint32   aClassId,
         const char* aClassName,
@@ -412,7 +445,11 @@ CipClass::CipClass(
 
     // create the standard instance services
     ServiceInsert( kGetAttributeSingle, GetAttributeSingle, "GetAttributeSingle" );
+    ServiceInsert( kGetAttributeSingleFragmented, GetAttributeSingleFragmented,
+            "GetAttributeSingleFragmented" );
     ServiceInsert( kSetAttributeSingle, SetAttributeSingle, "SetAttributeSingle" );
+    ServiceInsert( kGetAttributeList, GetAttributeList, "GetAttributeList" );
+    ServiceInsert( kSetAttributeList, SetAttributeList, "SetAttributeList" );
 
     if( get_attribute_all_mask )
     {
@@ -444,6 +481,7 @@ CipClass::CipClass(
     */
 
     ServiceInsert( kGetAttributeSingle, GetAttributeSingle, "GetAttributeSingle" );
+    ServiceInsert( kGetAttributeList, GetAttributeList, "GetAttributeList" );
 
     // create the standard class services
     if( get_attribute_all_mask )
@@ -520,13 +558,23 @@ int CipClass::FindUniqueFreeId() const
 
 CipService* CipClass::Service( int aServiceId ) const
 {
-    CipServices::const_iterator  it;
+    if( service_index.Indexed() )
+    {
+        CipService* service = service_index.Find( aServiceId );
+
+        if( service )
+            return service;
+    }
+    else
+    {
+        CipServices::const_iterator  it;
 
-    // binary search thru vector of pointers looking for attribute_id
-    it = vec_search( services.begin(), services.end(), aServiceId );
+        // binary search thru vector of pointers looking for attribute_id
+        it = vec_search( services.begin(), services.end(), aServiceId );
 
-    if( it != services.end() )
-        return *it;
+        if( it != services.end() )
+            return *it;
+    }
 
     CIPSTER_TRACE_WARN( "service %d not defined\n", aServiceId );
 
@@ -573,6 +621,14 @@ bool CipClass::InstanceInsert( CipInstance* aInstance )
     if( aInstance->highest_inst_attr_id > highest_attr_id )
         owning_class->highest_attr_id = aInstance->highest_inst_attr_id;
 
+    if( instance_index.Frozen() )
+    {
+        indexInstances();
+        aInstance->indexAttributes();
+    }
+
+    ++dispatch_generation;
+
     return true;
 }
 
@@ -594,6 +650,14 @@ CipInstance* CipClass::InstanceRemove( int aInstanceId )
         }
     }
 
+    if( ret )
+    {
+        if( instance_index.Frozen() )
+            indexInstances();
+
+        ++dispatch_generation;
+    }
+
     return ret;
 }
 
@@ -603,13 +667,23 @@ CipInstance* CipClass::Instance( int aInstanceId ) const
     if( aInstanceId == 0 )
         return (CipInstance*)  this;        // cast away const-ness
 
-    CipInstances::const_iterator  it;
+    if( instance_index.Indexed() )
+    {
+        CipInstance* instance = instance_index.Find( aInstanceId );
 
-    // binary search thru the vector of pointers looking for id
-    it = vec_search( instances.begin(), instances.end(), aInstanceId );
+        if( instance )
+            return instance;
+    }
+    else
+    {
+        CipInstances::const_iterator  it;
 
-    if( it != instances.end() )
-        return *it;
+        // binary search thru the vector of pointers looking for id
+        it = vec_search( instances.begin(), instances.end(), aInstanceId );
+
+        if( it != instances.end() )
+            return *it;
+    }
 
     CIPSTER_TRACE_WARN( "instance %d not in class '%s'\n",
         aInstanceId, class_name.c_str() );
@@ -618,6 +692,50 @@ CipInstance* CipClass::Instance( int aInstanceId ) const
 }
 
 
+void CipClass::indexInstances()
+{
+    int highest = instances.size() ? instances.back()->Id() : 0;
+
+    // A meta-class holds its public class as instance 0.  A sparse class,
+    // such as a tag database, keeps being searched.
+    if( instance_index.Index( highest, instances.size(), 256 ) )
+    {
+        for( CipInstances::const_iterator it = instances.begin(); it != instances.end(); ++it )
+            instance_index.Put( (*it)->Id(), *it );
+    }
+}
+
+
+void CipClass::indexServices()
+{
+    int highest = services.size() ? services.back()->Id() : 0;
+
+    // service codes are a USINT, so this always indexes
+    if( service_index.Index( highest, services.size(), 256 ) )
+    {
+        for( CipServices::const_iterator it = services.begin(); it != services.end(); ++it )
+            service_index.Put( (*it)->Id(), *it );
+    }
+}
+
+
+void CipClass::FreezeDispatch()
+{
+    indexServices();
+    indexInstances();
+    indexAttributes();
+
+    for( CipInstances::const_iterator it = instances.begin(); it != instances.end(); ++it )
+    {
+        if( *it != this )
+            (*it)->indexAttributes();
+    }
+
+    if( !IsMetaClass() )
+        owning_class->FreezeDispatch();
+}
+
+
 CipClass::CipInstances::const_iterator CipClass::InstanceNext( int aInstanceId ) const
 {
     CipInstances::const_iterator it = vec_search_gte( instances.begin(), instances.end(), aInstanceId );
@@ -650,6 +768,11 @@ bool CipClass::ServiceInsert( CipService* aService )
 
     services.insert( it, aService );
 
+    if( service_index.Frozen() )
+        indexServices();
+
+    ++dispatch_generation;
+
     return true;
 }
 
@@ -686,6 +809,14 @@ CipService* CipClass::ServiceRemove( int aServiceId )
         }
     }
 
+    if( ret )
+    {
+        if( service_index.Frozen() )
+            indexServices();
+
+        ++dispatch_generation;
+    }
+
     return ret;
 }
 
@@ -707,6 +838,8 @@ int EncodeData( int aDataType, const void* data, BufWriter& aBuf )
     case kCipInt:
     case kCipUint:
     case kCipWord:
+    case kCipDate:
+    case kCipItime:
         aBuf.put16( *(EipUint16*) data );
         break;
 
@@ -714,6 +847,10 @@ int EncodeData( int aDataType, const void* data, BufWriter& aBuf )
     case kCipUdint:
     case kCipDword:
     case kCipReal:
+    case kCipStime:
+    case kCipTimeOfDay:
+    case kCipFtime:
+    case kCipTime:
         aBuf.put32( *(EipUint32*) data );
         break;
 
@@ -721,13 +858,17 @@ int EncodeData( int aDataType, const void* data, BufWriter& aBuf )
     case kCipUlint:
     case kCipLword:
     case kCipLreal:
+    case kCipLtime:
         aBuf.put64( *(EipUint64*) data );
         break;
 
-    case kCipStime:
-    case kCipDate:
-    case kCipTimeOfDay:
     case kCipDateAndTime:
+        {
+            CipDateAndTime* date_and_time = (CipDateAndTime*) data;
+
+            aBuf.put32( date_and_time->time_of_day );
+            aBuf.put16( date_and_time->date );
+        }
         break;
 
     case kCipString:
@@ -745,9 +886,6 @@ int EncodeData( int aDataType, const void* data, BufWriter& aBuf )
         break;
 
     case kCipString2:
-    case kCipFtime:
-    case kCipLtime:
-    case kCipItime:
     case kCipStringN:
         break;
 
@@ -760,9 +898,6 @@ int EncodeData( int aDataType, const void* data, BufWriter& aBuf )
         }
         break;
 
-    case kCipTime:
-        break;
-
     case kCipEngUnit:
         break;
 
@@ -837,21 +972,39 @@ int DecodeData( int aDataType, void* data, BufReader& aBuf )
     case kCipInt:
     case kCipUint:
     case kCipWord:
+    case kCipDate:
+    case kCipItime:
         *(EipUint16*) data = aBuf.get16();
         break;
 
     case kCipDint:
     case kCipUdint:
     case kCipDword:
+    case kCipReal:
+    case kCipStime:
+    case kCipTimeOfDay:
+    case kCipFtime:
+    case kCipTime:
         *(EipUint32*) data = aBuf.get32();
         break;
 
     case kCipLint:
     case kCipUlint:
     case kCipLword:
+    case kCipLreal:
+    case kCipLtime:
         *(EipUint64*) data = aBuf.get64();
         break;
 
+    case kCipDateAndTime:
+        {
+            CipDateAndTime* date_and_time = (CipDateAndTime*) data;
+
+            date_and_time->time_of_day = aBuf.get32();
+            date_and_time->date        = aBuf.get16();
+        }
+        break;
+
     case kCipByteArray:
         // this code has no notion of buffer overrun protection or memory ownership, be careful.
         {
@@ -869,7 +1022,7 @@ int DecodeData( int aDataType, void* data, BufReader& aBuf )
     case kCipString:
         {
             CipString* string = (CipString*) data;
-            string->length = *aBuf++;
+            string->length = aBuf.get16();
             memcpy( string->string, aBuf.data(), string->length );
             aBuf += string->length;
 
@@ -902,6 +1055,66 @@ int DecodeData( int aDataType, void* data, BufReader& aBuf )
 }
 
 
+/**
+ * Function encodedSize
+ * returns how many bytes DecodeData() would consume from the front of aBuf
+ * for aDataType, or -1 if that type is not one DecodeData() knows.
+ */
+static int encodedSize( int aDataType, const void* data, BufReader aBuf )
+{
+    switch( aDataType )
+    {
+    case kCipBool:
+    case kCipSint:
+    case kCipUsint:
+    case kCipByte:
+        return 1;
+
+    case kCipInt:
+    case kCipUint:
+    case kCipWord:
+    case kCipDate:
+    case kCipItime:
+        return 2;
+
+    case kCipDint:
+    case kCipUdint:
+    case kCipDword:
+    case kCipReal:
+    case kCipStime:
+    case kCipTimeOfDay:
+    case kCipFtime:
+    case kCipTime:
+        return 4;
+
+    case kCipLint:
+    case kCipUlint:
+    case kCipLword:
+    case kCipLreal:
+    case kCipLtime:
+        return 8;
+
+    case kCipDateAndTime:
+        return 6;
+
+    case kCipByteArray:
+        return ((const CipByteArray*) data)->length;
+
+    case kCipString:
+        {
+            int byte_count = 2 + aBuf.get16();
+            return byte_count + (byte_count & 1);   // padded to even
+        }
+
+    case kCipShortString:
+        return 1 + *aBuf;
+
+    default:
+        return -1;
+    }
+}
+
+
 EipStatus GetAttributeSingle( CipInstance* instance,
         CipMessageRouterRequest* request,
         CipMessageRouterResponse* response )
@@ -953,12 +1166,160 @@ EipStatus GetAttributeSingle( CipInstance* instance,
 }
 
 
+EipStatus GetAttributeSingleFragmented( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response )
+{
+    CipAttribute* attribute = instance->Attribute( request->request_path.GetAttribute() );
+
+    if( !attribute || !( attribute->attribute_flags & kGetableSingle ) )
+    {
+        response->general_status = kCipErrorAttributeNotSupported;
+        return kEipStatusOkSend;
+    }
+
+    BufReader in = request->data;
+
+    if( in.size() < 4 )
+    {
+        response->general_status = kCipErrorNotEnoughData;
+        return kEipStatusOkSend;
+    }
+
+    EipUint32 offset = in.get32();
+
+    // The encoded attribute is head, body and pad, in that order.
+    EipByte         head[2];
+    int             head_size = 0;
+    const EipByte*  body;
+    int             body_size;
+    int             pad_size = 0;
+
+    bool streamed = attribute->Getter() == GetAttrData ||
+                    attribute->Getter() == TypedAttribute<CipString>::get;
+
+    if( attribute->Id() == 3 && instance->owning_class &&
+        instance->owning_class->ClassId() == kCipAssemblyClassCode )
+    {
+        AssemblyInstance* assembly = static_cast<AssemblyInstance*>( instance );
+
+        // what the assembly's own getter does before encoding the data
+        assembly->RefreshSnapshot();
+        BeforeAssemblyDataSend( instance );
+
+        body      = assembly->byte_array.data;
+        body_size = assembly->byte_array.length;
+    }
+    else if( streamed && attribute->type == kCipByteArray )
+    {
+        CipByteArray* byte_array = (CipByteArray*) attribute->data;
+
+        body      = byte_array->data;
+        body_size = byte_array->length;
+    }
+    else if( streamed && attribute->type == kCipString )
+    {
+        CipString* string = (CipString*) attribute->data;
+
+        BufWriter( head, sizeof head ).put16( string->length );
+
+        head_size = 2;
+        body      = string->string;
+        body_size = string->length;
+        pad_size  = string->length & 1;
+    }
+    else
+    {
+        // Anything else is encoded whole and sliced in place, so it must
+        // fit a reply.
+        try
+        {
+            attribute->Get( request, response );
+        }
+        catch( const std::overflow_error& )
+        {
+            response->general_status = kCipErrorReplyDataTooLarge;
+            response->data_length = 0;
+            return kEipStatusOkSend;
+        }
+
+        if( response->general_status != kCipErrorSuccess )
+            return kEipStatusOkSend;
+
+        body      = response->data.data();
+        body_size = response->data_length;
+    }
+
+    EipUint32 total = head_size + body_size + pad_size;
+
+    if( offset > total || ( offset == total && total ) )
+    {
+        response->general_status = kCipErrorInvalidParameter;
+        response->data_length = 0;
+        return kEipStatusOkSend;
+    }
+
+    int slice = total - offset;
+    int room  = response->data.size();
+
+    if( slice > room )
+    {
+        if( room < 1 )
+        {
+            response->general_status = kCipErrorReplyDataTooLarge;
+            response->data_length = 0;
+            return kEipStatusOkSend;
+        }
+
+        slice = room;
+        response->general_status = kCipErrorPartialTransfer;
+    }
+
+    EipByte*    dst = response->data.data();
+    int         pos = offset;
+    int         end = offset + slice;
+
+    for( ; pos < head_size && pos < end;  ++pos )
+        *dst++ = head[pos];
+
+    if( pos < end && pos < head_size + body_size )
+    {
+        int count = std::min( end, head_size + body_size ) - pos;
+
+        // body may be the reply itself, a little further on
+        memmove( dst, body + pos - head_size, count );
+
+        dst += count;
+        pos += count;
+    }
+
+    for( ; pos < end;  ++pos )
+        *dst++ = 0;         // the pad
+
+    response->data_length = dst - response->data.data();
+
+    return kEipStatusOkSend;
+}
+
+
 EipStatus GetAttributeAll( CipInstance* instance,
         CipMessageRouterRequest* request,
         CipMessageRouterResponse* response )
 {
     BufWriter start = response->data;
 
+    const std::vector<EipByte>* cached = instance->CachedAttributeAll();
+
+    if( cached )
+    {
+        BufWriter out = response->data;
+
+        out.append( cached->data(), cached->size() );
+
+        response->data_length = cached->size();
+        return kEipStatusOkSend;
+    }
+
     CipService* service = instance->owning_class->Service( kGetAttributeSingle );
 
     if( service )
@@ -1004,6 +1365,8 @@ EipStatus GetAttributeAll( CipInstance* instance,
             CIPSTER_TRACE_INFO( "%s: response->data_length:%d\n", __func__, response->data_length );
 
             response->data = start;
+
+            instance->SetCachedAttributeAll( start.data(), response->data_length );
         }
 
         return kEipStatusOkSend;
@@ -1016,6 +1379,23 @@ EipStatus GetAttributeAll( CipInstance* instance,
 }
 
 
+void InvalidateAttributeAllCaches( int aClassId )
+{
+    CipClass* clazz = GetCipClass( aClassId );
+
+    if( !clazz )
+        return;     // not initialized yet, nothing cached
+
+    const CipClass::CipInstances& instances = clazz->Instances();
+
+    for( CipClass::CipInstances::const_iterator it = instances.begin();
+            it != instances.end(); ++it )
+    {
+        (*it)->InvalidateAttributeAll();
+    }
+}
+
+
 EipStatus SetAttributeSingle( CipInstance* instance,
         CipMessageRouterRequest* request,
         CipMessageRouterResponse* response )
@@ -1035,6 +1415,8 @@ EipStatus SetAttributeSingle( CipInstance* instance,
                 instance->Id()
                 );
 
+            instance->InvalidateAttributeAll();
+
             // Set() is very "attribute specific" and is determined by which
             // AttributeFunc is installed into the attribute, if any.
             return attribute->Set( request, response );
@@ -1054,3 +1436,167 @@ EipStatus SetAttributeSingle( CipInstance* instance,
 }
 
 
+EipStatus GetAttributeList( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response )
+{
+    BufReader   in = request->data;
+    BufWriter   start = response->data;
+    BufWriter   out = response->data;
+    CipError    list_status = kCipErrorSuccess;
+
+    try
+    {
+        unsigned count = in.get16();
+
+        if( in.size() != 2 * count )
+        {
+            response->general_status = in.size() < 2 * count ?
+                    kCipErrorNotEnoughData : kCipErrorTooMuchData;
+            return kEipStatusOkSend;
+        }
+
+        out.put16( count );
+
+        for( unsigned i = 0; i < count; ++i )
+        {
+            int attribute_id = in.get16();
+
+            out.put16( attribute_id );
+
+            // the status goes here, the data if any behind it
+            BufWriter   status_field = out;
+            CipError    status = kCipErrorAttributeNotSupported;
+
+            out += 2;
+
+            CipAttribute* attribute = instance->Attribute( attribute_id );
+
+            if( attribute && (attribute->attribute_flags & kGetableSingle) )
+            {
+                request->request_path.SetAttribute( attribute_id );
+
+                response->data = out;
+                response->data_length = 0;
+                response->general_status = kCipErrorSuccess;
+
+                attribute->Get( request, response );
+
+                status = response->general_status;
+
+                if( status == kCipErrorSuccess )
+                    out += response->data_length;
+            }
+
+            status_field.put16( status );
+
+            if( status != kCipErrorSuccess )
+                list_status = kCipErrorAttributeListError;
+        }
+    }
+    catch( const std::overflow_error& )
+    {
+        list_status = kCipErrorReplyDataTooLarge;
+        out = start;
+    }
+    catch( const std::range_error& )
+    {
+        list_status = kCipErrorNotEnoughData;
+        out = start;
+    }
+
+    response->data = start;
+    response->data_length = out.data() - start.data();
+    response->general_status = list_status;
+
+    return kEipStatusOkSend;
+}
+
+
+EipStatus SetAttributeList( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response )
+{
+    BufReader   in = request->data;
+    BufWriter   start = response->data;
+    BufWriter   out = response->data;
+    CipError    list_status = kCipErrorSuccess;
+
+    try
+    {
+        unsigned count = in.get16();
+        unsigned done  = 0;
+
+        out += 2;   // count, filled in below
+
+        while( done < count )
+        {
+            int attribute_id = in.get16();
+
+            ++done;
+            out.put16( attribute_id );
+
+            CipAttribute*   attribute = instance->Attribute( attribute_id );
+            int             value_size = attribute ?
+                                encodedSize( attribute->type, attribute->data, in ) : -1;
+
+            if( value_size < 0 || in.size() < (size_t) value_size )
+            {
+                // Without the length of this value the ones behind it
+                // cannot be found, so the list ends here.
+                out.put16( !attribute ? kCipErrorAttributeNotSupported :
+                           value_size < 0 ? kCipErrorAttributeNotSetable :
+                           kCipErrorNotEnoughData );
+                list_status = kCipErrorAttributeListError;
+                break;
+            }
+
+            CipError status = kCipErrorAttributeNotSetable;
+
+            if( attribute->attribute_flags & kSetable )
+            {
+                CipMessageRouterRequest value = *request;
+
+                value.request_path.SetAttribute( attribute_id );
+                value.data = BufReader( in.data(), value_size );
+
+                response->general_status = kCipErrorSuccess;
+
+                instance->InvalidateAttributeAll();
+
+                EipStatus result = attribute->Set( &value, response );
+
+                status = response->general_status;
+
+                if( status == kCipErrorSuccess && result == kEipStatusError )
+                    status = kCipErrorInvalidAttributeValue;
+            }
+
+            in += value_size;
+            out.put16( status );
+
+            if( status != kCipErrorSuccess )
+                list_status = kCipErrorAttributeListError;
+        }
+
+        BufWriter( start.data(), 2 ).put16( done );
+    }
+    catch( const std::overflow_error& )
+    {
+        list_status = kCipErrorReplyDataTooLarge;
+        out = start;
+    }
+    catch( const std::range_error& )
+    {
+        list_status = kCipErrorNotEnoughData;
+        out = start;
+    }
+
+    response->data = start;
+    response->data_length = out.data() - start.data();
+    response->general_status = list_status;
+
+    return kEipStatusOkSend;
+}
+
+
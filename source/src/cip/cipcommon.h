@@ -38,6 +38,23 @@ EipStatus GetAttributeSingle( CipInstance* instance,
         CipMessageRouterResponse* response );
 
 
+/**
+ * Function GetAttributeSingleFragmented
+ * is a CipServiceFunction for the vendor specific service
+ * kGetAttributeSingleFragmented, for reading an attribute too large for one
+ * reply.  The request holds a UDINT byte offset into the attribute as
+ * GetAttributeSingle would encode it.  The reply holds what follows that
+ * offset and fits the reply, with status kCipErrorPartialTransfer if more
+ * remains.  A byte array or string attribute with the standard getter, and
+ * an assembly's data attribute 3, are copied straight from their data, so
+ * only the reply buffer is used.  Other attributes are encoded whole first,
+ * as by GetAttributeSingle.
+ */
+EipStatus GetAttributeSingleFragmented( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response );
+
+
 EipStatus SetAttributeSingle( CipInstance* instance,
         CipMessageRouterRequest* request,
         CipMessageRouterResponse* response );
@@ -56,4 +73,41 @@ EipStatus GetAttributeAll( CipInstance* instance,
         CipMessageRouterRequest* request,
         CipMessageRouterResponse* response );
 
+
+/**
+ * Function InvalidateAttributeAllCaches
+ * drops the GetAttributeAll() reply cached for each instance of class
+ * aClassId.  Call it after changing a value behind one of their attributes
+ * other than through a Set service, e.g. from SetDeviceStatus().
+ */
+void InvalidateAttributeAllCaches( int aClassId );
+
+
+/**
+ * Function GetAttributeList
+ * is an implementation of CipServiceFunction that provides a generic
+ * Get_Attribute_List CIP service.  The request holds a UINT count followed
+ * by that many UINT attribute ids.  The reply holds the count and, for each
+ * id, the id, a UINT status and, only if that status is zero, the data.
+ * Each attribute is read through CipAttribute::Get().
+ */
+EipStatus GetAttributeList( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response );
+
+
+/**
+ * Function SetAttributeList
+ * is an implementation of CipServiceFunction that provides a generic
+ * Set_Attribute_List CIP service.  The request holds a UINT count followed
+ * by that many UINT attribute id and value pairs.  The reply holds the count
+ * and, for each id, the id and a UINT status.  Each attribute is written
+ * through CipAttribute::Set().  A value's length comes from its attribute's
+ * type, so the list stops at an unknown attribute or one of a type which
+ * DecodeData() does not know, such as kCipAny.
+ */
+EipStatus SetAttributeList( CipInstance* instance,
+        CipMessageRouterRequest* request,
+        CipMessageRouterResponse* response );
+
 #endif    // CIPSTER_CIPCOMMON_H_
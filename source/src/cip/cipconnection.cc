@@ -17,12 +17,18 @@
 #include "cpf.h"
 #include "trace.h"
 #include "byte_bufs.h"
+#include "cipevents.h"
 
-// The port to be used per default for I/O messages on UDP.
-const int kOpenerEipIoUdpPort = 2222;   // = 0x08AE;
+EipUint32 g_run_idle_state;    //*< buffer for holding the run idle information.
 
+/// The longest ConsumedPacketSize() of the connections opened so far
+static int consumed_packet_size_max = CIPSTER_IO_PACKET_HEADER_SIZE + 2 + 4;
 
-EipUint32 g_run_idle_state;    //*< buffer for holding the run idle information.
+
+int ConsumedPacketSizeMax()
+{
+    return consumed_packet_size_max;
+}
 
 
 /* producing multicast connections have to consider the rules that apply for
@@ -87,7 +93,7 @@ static ConnectionManagerStatusCode handleConfigData( CipConn* aConn )
     }
 
     // Put the data into the configuration assembly object
-    else if( kEipStatusOk != NotifyAssemblyConnectedDataReceived( instance,
+    else if( kEipStatusOk != NotifyAssemblyConfigDataReceived( instance,
              BufReader( (EipByte*)  words.data(),  words.size() * 2 ) ) )
     {
         CIPSTER_TRACE_WARN( "Configuration data was invalid\n" );
@@ -170,10 +176,16 @@ void CipConn::Clear()
     sequence_count_producing = 0;
     sequence_count_consuming = 0;
 
-    transmission_trigger_timer_usecs = 0;
-    inactivity_watchdog_timer_usecs = 0;
+    produced_header_length = 0;
+    produced_data = NULL;
 
-    production_inhibit_timer_usecs = 0;
+    for( int i = 0; i < kConnTimerCount; ++i )
+    {
+        deadline_usecs[i] = 0;
+        timer_pos[i] = -1;
+    }
+
+    production_inhibit_deadline_usecs = 0;
 
     memset( &remote_address, 0, sizeof remote_address );
 
@@ -194,6 +206,20 @@ void CipConn::Clear()
 }
 
 
+void CipConn::SetWatchdogTimeoutUSecs( EipUint32 aUSecs )
+{
+    deadline_usecs[kConnTimerWatchdog] = ConnectionTimeUSecs() + aUSecs;
+    RescheduleConnectionTimer( this, kConnTimerWatchdog );
+}
+
+
+void CipConn::SetTransmissionDeadlineUSecs( EipUint64 aDeadline )
+{
+    deadline_usecs[kConnTimerTransmission] = aDeadline;
+    RescheduleConnectionTimer( this, kConnTimerTransmission );
+}
+
+
 void GeneralConnectionConfiguration( CipConn* aConn )
 {
     if( aConn->o_to_t_ncp.ConnectionType() == kIOConnTypePointToPoint )
@@ -233,7 +259,7 @@ void GeneralConnectionConfiguration( CipConn* aConn )
          * here we will produce with the next timer tick
          * which should be sufficient.
          */
-        aConn->transmission_trigger_timer_usecs = 0;
+        aConn->SetTransmissionDeadlineUSecs( ConnectionTimeUSecs() );
     }
     else
     {
@@ -241,16 +267,17 @@ void GeneralConnectionConfiguration( CipConn* aConn )
         aConn->SetExpectedPacketRateUSecs( aConn->o_to_t_RPI_usecs );
     }
 
-    aConn->production_inhibit_timer_usecs = 0;
+    aConn->production_inhibit_deadline_usecs = 0;
 
     aConn->SetPIT_USecs( 0 );
 
     // setup the preconsuption timer: max(ConnectionTimeoutMultiplier * EpectetedPacketRate, 10s)
-    aConn->inactivity_watchdog_timer_usecs = std::max(
+    EipUint32 watchdog_usecs = std::max(
             aConn->o_to_t_RPI_usecs << (2 + aConn->connection_timeout_multiplier), 10000000u );
 
-    CIPSTER_TRACE_INFO( "%s: inactivity_watchdog_timer_usecs:%u\n", __func__,
-            aConn->inactivity_watchdog_timer_usecs );
+    aConn->SetWatchdogTimeoutUSecs( watchdog_usecs );
+
+    CIPSTER_TRACE_INFO( "%s: inactivity watchdog:%u usecs\n", __func__, watchdog_usecs );
 
     aConn->consuming_connection_size = aConn->o_to_t_ncp.ConnectionSize();
     aConn->producing_connection_size = aConn->t_to_o_ncp.ConnectionSize();
@@ -265,7 +292,7 @@ void GeneralConnectionConfiguration( CipConn* aConn )
  */
 static void closeIoConnection( CipConn* aConn )
 {
-    CheckIoConnectionEvent(
+    NotifyIoConnectionEvent(
             aConn->conn_path.consuming_path.GetInstanceOrConnPt(),
             aConn->conn_path.producing_path.GetInstanceOrConnPt(),
             kIoConnectionEventClosed
@@ -295,8 +322,8 @@ static void closeIoConnection( CipConn* aConn )
 
                 aConn->producing_socket = kEipInvalidSocket;
 
-                next_non_control_master_connection->transmission_trigger_timer_usecs =
-                    aConn->transmission_trigger_timer_usecs;
+                next_non_control_master_connection->SetTransmissionDeadlineUSecs(
+                    aConn->deadline_usecs[kConnTimerTransmission] );
             }
             else // this was the last master connection close all listen only connections listening on the port
             {
@@ -312,111 +339,313 @@ static void closeIoConnection( CipConn* aConn )
 
 
 /**
- * Function sendConnectedData
- * sends the data from the producing CIP Object of the connection via the socket
- * of the connection instance on UDP.
- *
- *      @param cip_conn  pointer to the connection object
- *      @return status  EIP_OK .. success
- *                     EIP_ERROR .. error
+ * Function buildProducedHeader
+ * serializes the part of a class 0/1 packet of the connection which does not
+ * change from one packet to the next: everything in front of the payload,
+ * with zeros for the sequence numbers and the run/idle word.  The data item
+ * length is rewritten for each packet too, from the payload's length then.
  */
-static EipStatus sendConnectedData( CipConn* aConn )
+static void buildProducedHeader( CipConn* aConn )
 {
-    EipStatus result;
+    CipAttribute* attr3 = aConn->producing_instance->Attribute( 3 );
+    CIPSTER_ASSERT( attr3 );
 
-    /*
-        TODO think of adding an own send buffer to each connection object in
-        order to pre-setup the whole message on connection opening and just
-        change the variable data items e.g., sequence number
-    */
-    CipCommonPacketFormatData cpfd;
+    CipByteArray* attr3_byte_array = (CipByteArray*) attr3->data;
+    CIPSTER_ASSERT( attr3_byte_array );
 
-    aConn->eip_level_sequence_count_producing++;
+    bool is_class1 = aConn->transport_trigger.Class() == kConnectionTransportClass1;
 
-    // assembleCPFData
-    cpfd.SetItemCount( 2 );
+    int data_length = attr3_byte_array->length;
+
+    if( kOpenerProducedDataHasRunIdleHeader )
+        data_length += 4;
+
+    if( is_class1 )
+        data_length += 2;
+
+    BufWriter out( aConn->produced_header, sizeof aConn->produced_header );
+
+    out.put16( 2 );     // item count
 
     // use Sequenced Address Items if not Connection Class 0
     if( aConn->transport_trigger.Class() != kConnectionTransportClass0 )
     {
-        cpfd.address_item.type_id = kCipItemIdSequencedAddressItem;
-        cpfd.address_item.length  = 8;
-        cpfd.address_item.data.sequence_number = aConn->eip_level_sequence_count_producing;
+        out.put16( kCipItemIdSequencedAddressItem );
+        out.put16( 8 );
+        out.put32( aConn->producing_connection_id );
+        out.put32( 0 );
     }
     else
     {
-        cpfd.address_item.type_id = kCipItemIdConnectionAddress;
-        cpfd.address_item.length  = 4;
+        out.put16( kCipItemIdConnectionAddress );
+        out.put16( 4 );
+        out.put32( aConn->producing_connection_id );
     }
 
+    out.put16( kCipItemIdConnectedDataItem );
+    out.put16( data_length );
+
+    if( is_class1 )
+        out.put16( 0 );
+
+    if( kOpenerProducedDataHasRunIdleHeader )
+        out.put32( 0 );
+
+    aConn->produced_header_length = out.data() - aConn->produced_header;
+    aConn->produced_data = attr3_byte_array;
+}
+
+
+/**
+ * Function serializeProducedHeader
+ * serializes the header of a class 0/1 packet carrying the data of the
+ * producing CIP Object of the connection, from the connection's
+ * produced_header.  The payload is aConn->produced_data, to be sent from
+ * where it is.
+ *
+ *      @param aConn  pointer to the connection object
+ *      @param aOutput where to put the header
+ *      @return int - the header's byte count, or -1 on error
+ */
+static int serializeProducedHeader( CipConn* aConn, BufWriter aOutput )
+{
+    aConn->eip_level_sequence_count_producing++;
+
+    // take the newest image of a snapshot assembly, a new one counts as changed
+    bool changed = static_cast<AssemblyInstance*>( aConn->producing_instance )->RefreshSnapshot();
+
     // notify the application that data will be sent immediately after the call
-    if( BeforeAssemblyDataSend( aConn->producing_instance ) )
+    if( BeforeAssemblyDataSend( aConn->producing_instance ) || changed )
     {
         // the data has changed, increase sequence counter
         aConn->sequence_count_producing++;
     }
 
-    cpfd.address_item.data.connection_identifier = aConn->producing_connection_id;
+    int header_length = aConn->produced_header_length;
 
-    cpfd.data_item.type_id = kCipItemIdConnectedDataItem;
+    if( header_length > (int) aOutput.size() )
+        return -1;
 
-    CipAttribute* attr3 = aConn->producing_instance->Attribute( 3 );
-    CIPSTER_ASSERT( attr3 );
+    EipByte* frame = aOutput.data();
 
-    CipByteArray* attr3_byte_array = (CipByteArray*) attr3->data;
-    CIPSTER_ASSERT( attr3_byte_array );
+    memcpy( frame, aConn->produced_header, header_length );
 
-    cpfd.data_item.length = 0;
+    // the fields which vary are at fixed offsets, see buildProducedHeader()
+    int length_at = 12;     // data item length after a connection address item
 
-    // set AddressInfo Items to invalid Type
-    cpfd.ClearTx();
+    if( aConn->transport_trigger.Class() != kConnectionTransportClass0 )
+    {
+        BufWriter( frame + 10, 4 ).put32( aConn->eip_level_sequence_count_producing );
+        length_at = 16;
+    }
 
-    BufWriter out_cpfd( g_message_data_reply_buffer, sizeof g_message_data_reply_buffer );
+    // the application may have resized the assembly since OpenIO()
+    BufWriter( frame + length_at, 2 ).put16(
+            aConn->produced_data->length + header_length - (length_at + 2) );
 
-    int reply_length = cpfd.SerializeForIO( out_cpfd );
+    int tail = header_length;
 
-    if( reply_length < 0 )
+    if( kOpenerProducedDataHasRunIdleHeader )
     {
-        return kEipStatusError;
+        tail -= 4;
+        BufWriter( frame + tail, 4 ).put32( g_run_idle_state );
+    }
+
+    if( aConn->transport_trigger.Class() == kConnectionTransportClass1 )
+    {
+        tail -= 2;
+        BufWriter( frame + tail, 2 ).put16( aConn->sequence_count_producing );
     }
 
-    BufWriter out = out_cpfd + (reply_length - 2);
+    return header_length;
+}
 
-    cpfd.data_item.length = attr3_byte_array->length;
 
-    if( kOpenerProducedDataHasRunIdleHeader )
+//-----<ProductionBatch>--------------------------------------------------------
+
+static bool         batch_is_open;
+static int          batch_count;
+static int          batch_failed_count;     ///< by sends of full batches, for ProductionBatchFlush()
+static CipConn*     batch_conns[CIPSTER_PRODUCTION_BATCH_SIZE];
+static UdpSendItem  batch_items[CIPSTER_PRODUCTION_BATCH_SIZE];
+
+// the header of each batched packet, its payload stays with the connection
+static EipByte      batch_packets[CIPSTER_PRODUCTION_BATCH_SIZE][sizeof CipConn::produced_header];
+
+
+void ProductionBatchOpen()
+{
+    batch_is_open = true;
+    batch_count   = 0;
+    batch_failed_count = 0;
+}
+
+
+/**
+ * Function sendBatch
+ * sends the batched packets, grouped by socket, and reports failures.
+ */
+static int sendBatch()
+{
+    UdpSendItem grouped[CIPSTER_PRODUCTION_BATCH_SIZE];
+    CipConn*    conns[CIPSTER_PRODUCTION_BATCH_SIZE];
+    int         count = 0;
+
+    // Drop removed entries and make entries sharing a socket adjacent,
+    // a stable insertion sort since the batch is small.
+    for( int i = 0; i < batch_count;  ++i )
     {
-        cpfd.data_item.length += 4;
+        if( !batch_conns[i] )
+            continue;
+
+        int j = count++;
+
+        while( j > 0 && grouped[j-1].socket > batch_items[i].socket )
+        {
+            grouped[j] = grouped[j-1];
+            conns[j]   = conns[j-1];
+            --j;
+        }
+
+        grouped[j] = batch_items[i];
+        grouped[j].result = kEipStatusError;
+        conns[j]   = batch_conns[i];
     }
 
-    if( aConn->transport_trigger.Class() == kConnectionTransportClass1 )
+    batch_count = 0;
+
+    if( !count )
+        return 0;
+
+    SendUdpDataBatch( grouped, count );
+
+    int failed_count = 0;
+
+    for( int i = 0; i < count;  ++i )
     {
-        cpfd.data_item.length += 2;
+        if( grouped[i].result == kEipStatusError )
+        {
+            CIPSTER_TRACE_ERR( "sending of UDP data in manage Connection failed, producing_connection_id:0x%x\n",
+                conns[i]->producing_connection_id );
 
-        out.put16( cpfd.data_item.length );
-        out.put16( aConn->sequence_count_producing );
+            ++failed_count;
+        }
     }
-    else
+
+    return failed_count;
+}
+
+
+int ProductionBatchFlush()
+{
+    int failed_count = batch_failed_count + sendBatch();
+
+    batch_failed_count = 0;
+    batch_is_open = false;
+
+    return failed_count;
+}
+
+
+void ProductionBatchRemove( CipConn* aConn )
+{
+    for( int i = 0; i < batch_count;  ++i )
     {
-        out.put16( cpfd.data_item.length );
+        if( batch_conns[i] == aConn )
+            batch_conns[i] = NULL;
     }
+}
 
-    if( kOpenerProducedDataHasRunIdleHeader )
+
+/**
+ * Function detachBatchedPayload
+ * copies the payload of any batched packet referring to @a aData into its
+ * connection's produced_copy.  Needed before BeforeAssemblyDataSend() is called
+ * again for an assembly already batched by another connection, since the
+ * application may change the data then, and a snapshot assembly may hand
+ * the batched image back to its writer.
+ */
+static void detachBatchedPayload( const CipByteArray* aData )
+{
+    for( int i = 0; i < batch_count;  ++i )
     {
-        out.put32( g_run_idle_state );
+        UdpSendItem& item = batch_items[i];
+
+        if( !batch_conns[i] || !item.data.size() || item.data.data() != aData->data )
+            continue;
+
+        std::vector<EipByte>& copy = batch_conns[i]->produced_copy;
+
+        // sized by OpenIO(), but the application may resize the assembly
+        if( copy.size() < item.data.size() )
+            copy.resize( item.data.size() );
+
+        memcpy( &copy[0], item.data.data(), item.data.size() );
+
+        item.data = BufReader( &copy[0], item.data.size() );
     }
+}
 
-    out.append( attr3_byte_array->data, attr3_byte_array->length );
 
-    reply_length += cpfd.data_item.length;
+/**
+ * Function sendConnectedData
+ * sends the data from the producing CIP Object of the connection via the socket
+ * of the connection instance on UDP.  Between ProductionBatchOpen() and
+ * ProductionBatchFlush() only the header is serialized into a batch slot.
+ * The payload is sent from the assembly's attribute 3, without a copy.
+ *
+ *      @param cip_conn  pointer to the connection object
+ *      @return status  EIP_OK .. success, or batched
+ *                     EIP_ERROR .. error
+ */
+static EipStatus sendConnectedData( CipConn* aConn )
+{
+    const CipByteArray* payload = aConn->produced_data;
 
-    result = SendUdpData(
-            &aConn->remote_address,
-            aConn->producing_socket,
-            BufReader( g_message_data_reply_buffer, reply_length )
-            );
+    if( batch_is_open )
+    {
+        if( batch_count == CIPSTER_PRODUCTION_BATCH_SIZE )
+            batch_failed_count += sendBatch();
 
-    return result;
+        detachBatchedPayload( payload );
+
+        BufWriter out( batch_packets[batch_count], sizeof batch_packets[batch_count] );
+
+        int length = serializeProducedHeader( aConn, out );
+
+        if( length < 0 )
+            return kEipStatusError;
+
+        UdpSendItem& item = batch_items[batch_count];
+
+        item.address = &aConn->remote_address;
+        item.socket  = aConn->producing_socket;
+        item.header  = BufReader( out.data(), length );
+        item.data    = BufReader( payload->data, payload->length );
+
+        batch_conns[batch_count++] = aConn;
+
+        return kEipStatusOk;
+    }
+
+    EipByte header[sizeof aConn->produced_header];
+
+    int length = serializeProducedHeader( aConn, BufWriter( header, sizeof header ) );
+
+    if( length < 0 )
+        return kEipStatusError;
+
+    UdpSendItem item;
+
+    item.address = &aConn->remote_address;
+    item.socket  = aConn->producing_socket;
+    item.header  = BufReader( header, length );
+    item.data    = BufReader( payload->data, payload->length );
+    item.result  = kEipStatusError;
+
+    SendUdpDataBatch( &item, 1 );
+
+    return item.result;
 }
 
 
@@ -444,7 +673,7 @@ static EipStatus handleReceivedIoConnectionData( CipConn* aConn, BufReader aInpu
 
             if( g_run_idle_state != nRunIdleBuf )
             {
-                RunIdleChanged( nRunIdleBuf );
+                NotifyRunIdleChanged( nRunIdleBuf );
             }
 
             g_run_idle_state = nRunIdleBuf;
@@ -464,7 +693,7 @@ static void handleIoConnectionTimeOut( CipConn* aConn )
 {
     CipConn* next_non_control_master_connection;
 
-    CheckIoConnectionEvent(
+    NotifyIoConnectionEvent(
         aConn->conn_path.consuming_path.GetInstanceOrConnPt(),
         aConn->conn_path.producing_path.GetInstanceOrConnPt(),
         kIoConnectionEventTimedOut
@@ -496,8 +725,8 @@ static void handleIoConnectionTimeOut( CipConn* aConn )
                         aConn->producing_socket;
                     aConn->producing_socket =
                         kEipInvalidSocket;
-                    next_non_control_master_connection->transmission_trigger_timer_usecs =
-                        aConn->transmission_trigger_timer_usecs;
+                    next_non_control_master_connection->SetTransmissionDeadlineUSecs(
+                        aConn->deadline_usecs[kConnTimerTransmission] );
                 }
 
                 // this was the last master connection close all listen only
@@ -879,6 +1108,14 @@ CipError CipConnectionClass::OpenIO( CipConn* aConn, CipCommonPacketFormatData*
             diff_size += 4;
         }
 
+        if( data_size > CIPSTER_IO_DATA_SIZE_MAX )
+        {
+            *extended_error = kConnectionManagerStatusCodeErrorInvalidOToTConnectionSize;
+
+            CIPSTER_TRACE_INFO( "%s: data_size > CIPSTER_IO_DATA_SIZE_MAX\n", __func__ );
+            return kCipErrorConnectionFailure;
+        }
+
         if( ( (CipByteArray*) attribute->data )->length != data_size )
         {
             // wrong connection size
@@ -890,6 +1127,9 @@ CipError CipConnectionClass::OpenIO( CipConn* aConn, CipCommonPacketFormatData*
             CIPSTER_TRACE_INFO( "%s: byte_array length != data_size\n", __func__ );
             return kCipErrorConnectionFailure;
         }
+
+        if( io_conn->ConsumedPacketSize() > consumed_packet_size_max )
+            consumed_packet_size_max = io_conn->ConsumedPacketSize();
     }
 
     if( t_to_o != kIOConnTypeNull )     // setup producer side
@@ -920,6 +1160,14 @@ CipError CipConnectionClass::OpenIO( CipConn* aConn, CipCommonPacketFormatData*
             diff_size += 4;
         }
 
+        if( data_size > CIPSTER_IO_DATA_SIZE_MAX )
+        {
+            *extended_error = kConnectionManagerStatusCodeErrorInvalidTToOConnectionSize;
+
+            CIPSTER_TRACE_INFO( "%s: data_size > CIPSTER_IO_DATA_SIZE_MAX\n", __func__ );
+            return kCipErrorConnectionFailure;
+        }
+
         if( ( (CipByteArray*) attribute->data )->length != data_size )
         {
             // wrong connection size
@@ -931,6 +1179,9 @@ CipError CipConnectionClass::OpenIO( CipConn* aConn, CipCommonPacketFormatData*
             CIPSTER_TRACE_INFO( "%s: bytearray length != data_size\n", __func__ );
             return kCipErrorConnectionFailure;
         }
+
+        // the negotiated T->O payload, without sequence count or run/idle header
+        io_conn->produced_copy.resize( data_size );
     }
 
     // If config data is present in forward_open request
@@ -955,9 +1206,13 @@ CipError CipConnectionClass::OpenIO( CipConn* aConn, CipCommonPacketFormatData*
         return result;
     }
 
+    // the producing_connection_id is final now
+    if( t_to_o != kIOConnTypeNull )
+        buildProducedHeader( io_conn );
+
     AddNewActiveConnection( io_conn );
 
-    CheckIoConnectionEvent(
+    NotifyIoConnectionEvent(
         io_conn->conn_path.consuming_path.GetInstanceOrConnPt(),
         io_conn->conn_path.producing_path.GetInstanceOrConnPt(),
         kIoConnectionEventOpened
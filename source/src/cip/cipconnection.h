@@ -40,6 +40,8 @@
 #ifndef CIPIOCONNECTION_H_
 #define CIPIOCONNECTION_H_
 
+#include <vector>
+
 #include "cipster_api.h"
 #include "cipepath.h"
 
@@ -60,6 +62,19 @@ enum ConnectionState
 };
 
 
+/**
+ * enum ConnTimerKind
+ * names the timers an active connection keeps in the connection manager's
+ * timer queue.  Each is an absolute deadline, see ConnectionTimeUSecs().
+ */
+enum ConnTimerKind
+{
+    kConnTimerWatchdog,         ///< inactivity watchdog
+    kConnTimerTransmission,     ///< next production
+    kConnTimerCount
+};
+
+
 //* @brief instance_type attributes
 enum ConnInstanceType
 {
@@ -377,11 +392,50 @@ public:
 
     EipUint16 sequence_count_producing;             /* sequence Count for Class 1 Producing
                                                      *  Connections */
+
+    /// The CPF of a produced class 0/1 packet up to its payload, built once by
+    /// OpenIO() so that producing only patches the sequence numbers and the
+    /// run/idle word.  Item count, address item and data item header, plus
+    /// the class 1 sequence count and the run/idle header.
+    EipByte     produced_header[2 + 4+8 + 4 + 2 + 4];
+    int         produced_header_length;     ///< 0 until built
+
+    CipByteArray* produced_data;            ///< attribute 3 of producing_instance
+
+    /// Room for a copy of produced_data, sized by OpenIO() from the
+    /// negotiated connection size, for a batched packet whose assembly
+    /// changes before the batch is sent.
+    std::vector<EipByte> produced_copy;
+
+    /// Return the size of the longest class 0/1 packet this connection consumes.
+    int ConsumedPacketSize() const
+    {
+        return consuming_connection_size + CIPSTER_IO_PACKET_HEADER_SIZE;
+    }
+
     EipUint16 sequence_count_consuming;             /* sequence Count for Class 1 Producing
                                                      *  Connections */
 
-    EipInt32    transmission_trigger_timer_usecs;   // signed 32 bits, in usecs
-    EipInt32    inactivity_watchdog_timer_usecs;    // signed 32 bits, in usecs
+    /// Absolute deadlines in usecs on the ConnectionTimeUSecs() clock,
+    /// indexed by ConnTimerKind.
+    EipUint64   deadline_usecs[kConnTimerCount];
+
+    /// Position of each deadline in the timer queue, -1 when not queued.
+    int         timer_pos[kConnTimerCount];
+
+    /**
+     * Function SetWatchdogTimeoutUSecs
+     * restarts the inactivity watchdog so it expires aUSecs from now.
+     * Pushing the deadline later is O(1) regardless of the number of
+     * active connections.
+     */
+    void SetWatchdogTimeoutUSecs( EipUint32 aUSecs );
+
+    /**
+     * Function SetTransmissionDeadlineUSecs
+     * sets the absolute time of the next production.
+     */
+    void SetTransmissionDeadlineUSecs( EipUint64 aDeadline );
 
     /**
      * Function GetProductionInhibitTimeUSecs
@@ -403,10 +457,10 @@ public:
         conn_path.port_segs.SetPIT_USecs( aUSECS );
     }
 
-    /** @brief Timer for the production inhibition of application triggered or
-     * change-of-state I/O connections.
+    /** @brief Absolute time before which an application triggered or
+     * change-of-state I/O connection may not produce again.
      */
-    EipInt32 production_inhibit_timer_usecs;
+    EipUint64 production_inhibit_deadline_usecs;
 
     sockaddr_in  remote_address;            // socket address for produce
     sockaddr_in  originator_address;        /* the address of the originator that
@@ -461,6 +515,34 @@ inline void CopyConnectionData( CipConn* aDst, CipConn* aSrc )
 void GeneralConnectionConfiguration( CipConn* cip_conn );
 
 
+/**
+ * Function ProductionBatchOpen
+ * starts collecting the output of connection_send_data_function for I/O
+ * connections, rather than sending it immediately.  Each connection is
+ * serialized into its own batch slot.  Sending happens in
+ * ProductionBatchFlush(), or early when all the slots are in use.
+ */
+void ProductionBatchOpen();
+
+/**
+ * Function ProductionBatchFlush
+ * sends everything collected since ProductionBatchOpen() using
+ * SendUdpDataBatch(), reports a failed send for each connection, and
+ * returns to sending immediately.
+ *
+ * @return int - the number of connections whose data could not be sent,
+ *  including those of batches sent early.
+ */
+int ProductionBatchFlush();
+
+/**
+ * Function ProductionBatchRemove
+ * forgets any batched output of @a aConn, needed when it is closed
+ * before the batch is flushed.
+ */
+void ProductionBatchRemove( CipConn* aConn );
+
+
 /**
  * Class CipConnection
  * wants to be class_id = 0x05 according to the CIP spec.
@@ -4,6 +4,8 @@
  *
  ******************************************************************************/
 #include <string.h>
+#include <algorithm>
+#include <vector>
 
 #include "cipconnectionmanager.h"
 
@@ -16,6 +18,8 @@
 #include "encap.h"
 #include "trace.h"
 #include "cipconnection.h"
+#include "cipconnindex.h"
+#include "cipconntimerqueue.h"
 #include "cipassembly.h"
 #include "cpf.h"
 #include "appcontype.h"
@@ -26,6 +30,71 @@
 CipConn* g_active_connection_list;
 
 
+static EipUint64 consumingIdKey( const CipConn* aConn )
+{
+    return EipUint32( aConn->consuming_connection_id );
+}
+
+
+static EipUint64 triadKey( EipUint16 aConnectionSerialNumber,
+        EipUint16 aOriginatorVendorId, EipUint32 aOriginatorSerialNumber )
+{
+    return (EipUint64( aOriginatorSerialNumber ) << 32)
+         | (EipUint32( aOriginatorVendorId ) << 16)
+         | aConnectionSerialNumber;
+}
+
+
+static EipUint64 triadKey( const CipConn* aConn )
+{
+    return triadKey( aConn->connection_serial_number,
+                aConn->originator_vendor_id,
+                aConn->originator_serial_number );
+}
+
+
+static bool isEstablished( const CipConn* aConn )
+{
+    return aConn->state == kConnectionStateEstablished;
+}
+
+
+static bool isEstablishedOrTimedOut( const CipConn* aConn )
+{
+    return aConn->state == kConnectionStateEstablished ||
+           aConn->state == kConnectionStateTimedOut;
+}
+
+
+/// Indices into g_active_connection_list, maintained by
+/// AddNewActiveConnection() and RemoveFromActiveConnections().
+static ConnIndex    by_consuming_id( consumingIdKey );
+static ConnIndex    by_triad( triadKey );
+
+
+static ConnTimerQueue   timer_queue;
+
+/// Time base of the deadlines, advanced one tick per ManageConnections()
+/// or set by ManageConnectionTimers().
+static EipUint64        conn_time_usecs;
+
+/// Set by the first ManageConnectionTimers(), from then on ManageConnections()
+/// leaves the connection timers alone.
+static bool             deadline_driven;
+
+
+EipUint64 ConnectionTimeUSecs()
+{
+    return conn_time_usecs;
+}
+
+
+void RescheduleConnectionTimer( CipConn* aConn, ConnTimerKind aKind )
+{
+    timer_queue.Reschedule( aConn, aKind );
+}
+
+
 /**
  * Function findExsitingMatchingConnection
  * finds an existing matching established connection.
@@ -41,24 +110,7 @@ CipConn* g_active_connection_list;
  */
 static CipConn* findExistingMatchingConnection( CipConn* aConn )
 {
-    CipConn* active = g_active_connection_list;
-
-    while( active )
-    {
-        if( active->state == kConnectionStateEstablished )
-        {
-            if( aConn->connection_serial_number == active->connection_serial_number
-             && aConn->originator_vendor_id     == active->originator_vendor_id
-             && aConn->originator_serial_number == active->originator_serial_number )
-            {
-                return active;
-            }
-        }
-
-        active = active->next;
-    }
-
-    return NULL;
+    return by_triad.Find( triadKey( aConn ), isEstablished );
 }
 
 
@@ -592,12 +644,13 @@ EipStatus HandleReceivedConnectedData( const sockaddr_in* from_address, BufReade
                                   conn->eip_level_sequence_count_consuming ) )
                     {
                         // reset the watchdog timer
-                        conn->inactivity_watchdog_timer_usecs =
+                        EipUint32 watchdog_usecs =
                             conn->o_to_t_RPI_usecs << (2 + conn->connection_timeout_multiplier);
 
+                        conn->SetWatchdogTimeoutUSecs( watchdog_usecs );
+
                         CIPSTER_TRACE_INFO( "%s: reset inactivity watchdog to %u usecs\n",
-                            __func__,
-                            conn->inactivity_watchdog_timer_usecs );
+                            __func__, watchdog_usecs );
 
                         conn->eip_level_sequence_count_consuming = cpfd.address_item.data.sequence_number;
 
@@ -635,17 +688,26 @@ EipStatus HandleReceivedConnectedData( const sockaddr_in* from_address, BufReade
 }
 
 
-EipStatus ManageConnections()
+/**
+ * Function expireConnectionTimers
+ * handles every connection timer due at conn_time_usecs.
+ */
+static void expireConnectionTimers()
 {
     EipStatus eip_status;
 
-    //Inform application that it can execute
-    HandleApplication();
-    ManageEncapsulationMessages();
+    // Serialize the output of all due connections first, then send it together.
+    ProductionBatchOpen();
 
-    for( CipConn* active = g_active_connection_list;  active;  active = active->next )
+    CipConn*        active;
+    ConnTimerKind   kind;
+
+    while( timer_queue.PopExpired( conn_time_usecs, &active, &kind ) )
     {
-        if( active->state == kConnectionStateEstablished )
+        if( active->state != kConnectionStateEstablished )
+            continue;
+
+        if( kind == kConnTimerWatchdog )
         {
             // We have a consuming connection check inactivity watchdog timer.
             if( active->consuming_instance ||
@@ -653,73 +715,89 @@ EipStatus ManageConnections()
                 // All server connections have to maintain an inactivity watchdog timer
                 active->transport_trigger.IsServer() )
             {
-                active->inactivity_watchdog_timer_usecs -= kOpenerTimerTickInMicroSeconds;
-
-                if( active->inactivity_watchdog_timer_usecs <= 0 )
-                {
-                    // we have a timed out connection: perform watchdog check
-                    CIPSTER_TRACE_INFO(
-                        "%s: >>>>>Connection timed out consuming_socket:%d producing_socket:%d\n",
-                        __func__,
-                        active->consuming_socket,
-                        active->producing_socket
-                        );
+                // we have a timed out connection: perform watchdog check
+                CIPSTER_TRACE_INFO(
+                    "%s: >>>>>Connection timed out consuming_socket:%d producing_socket:%d\n",
+                    __func__,
+                    active->consuming_socket,
+                    active->producing_socket
+                    );
 
-                    CIPSTER_ASSERT( active->connection_timeout_function );
+                CIPSTER_ASSERT( active->connection_timeout_function );
 
-                    active->connection_timeout_function( active );
-                }
+                active->connection_timeout_function( active );
             }
+        }
 
-            // only if the connection has not timed out check if data is to be sent
-            if( active->state == kConnectionStateEstablished )
-            {
-                // client connection
-                if( active->GetExpectedPacketRateUSecs() != 0 &&
+        // client connection
+        else if( active->GetExpectedPacketRateUSecs() != 0 &&
 
-                    // only produce for the master connection
-                    active->producing_socket != kEipInvalidSocket )
-                {
-                    if( active->transport_trigger.Trigger() != kConnectionTriggerTypeCyclic )
-                    {
-                        // non cyclic connections have to decrement production inhibit timer
-                        if( 0 <= active->production_inhibit_timer_usecs )
-                        {
-                            active->production_inhibit_timer_usecs -= kOpenerTimerTickInMicroSeconds;
-                        }
-                    }
+            // only produce for the master connection
+            active->producing_socket != kEipInvalidSocket )
+        {
+            // reload the timer value, keeping the phase unless we fell behind
+            EipUint64 next = active->deadline_usecs[kConnTimerTransmission] +
+                                active->GetExpectedPacketRateUSecs();
 
-                    active->transmission_trigger_timer_usecs -= kOpenerTimerTickInMicroSeconds;
+            if( next <= conn_time_usecs )
+                next = conn_time_usecs + active->GetExpectedPacketRateUSecs();
 
-                    if( active->transmission_trigger_timer_usecs <= 0 ) // need to send package
-                    {
-                        CIPSTER_ASSERT( active->connection_send_data_function );
+            active->SetTransmissionDeadlineUSecs( next );
 
-                        eip_status = active->connection_send_data_function( active );
+            if( active->transport_trigger.Trigger() != kConnectionTriggerTypeCyclic )
+            {
+                // non cyclic connections have to reload the production inhibit timer
+                active->production_inhibit_deadline_usecs =
+                    conn_time_usecs + active->GetPIT_USecs();
+            }
 
-                        if( eip_status == kEipStatusError )
-                        {
-                            CIPSTER_TRACE_ERR( "sending of UDP data in manage Connection failed\n" );
-                        }
+            CIPSTER_ASSERT( active->connection_send_data_function );
 
-                        // reload the timer value
-                        active->transmission_trigger_timer_usecs = active->GetExpectedPacketRateUSecs();
+            eip_status = active->connection_send_data_function( active );
 
-                        if( active->transport_trigger.Trigger() != kConnectionTriggerTypeCyclic )
-                        {
-                            // non cyclic connections have to reload the production inhibit timer
-                            active->production_inhibit_timer_usecs = active->GetPIT_USecs();
-                        }
-                    }
-                }
+            // only a failed serialization shows here, a failed
+            // send is reported by ProductionBatchFlush()
+            if( eip_status == kEipStatusError )
+            {
+                CIPSTER_TRACE_ERR( "sending of UDP data in manage Connection failed\n" );
             }
         }
     }
 
+    ProductionBatchFlush();
+}
+
+
+EipStatus ManageConnections()
+{
+    //Inform application that it can execute
+    HandleApplication();
+    ManageEncapsulationMessages();
+
+    if( !deadline_driven )
+    {
+        conn_time_usecs += kOpenerTimerTickInMicroSeconds;
+        expireConnectionTimers();
+    }
+
     return kEipStatusOk;
 }
 
 
+EipUint64 ManageConnectionTimers( EipUint64 aNowUSecs )
+{
+    deadline_driven = true;
+
+    // never let the time base go backwards
+    if( aNowUSecs > conn_time_usecs )
+        conn_time_usecs = aNowUSecs;
+
+    expireConnectionTimers();
+
+    return std::min( timer_queue.NextDeadline(), ManageEncapsulationMessages() );
+}
+
+
 /**
  * Function assembleForwardOpenResponse
  * serializes a response to a forward_open
@@ -810,22 +888,7 @@ static void assembleForwardOpenResponse( CipConn* aConn,
 
 CipConn* GetConnectionByConsumingId( int aConnectionId )
 {
-    CipConn* conn = g_active_connection_list;
-
-    while( conn )
-    {
-        if( conn->state == kConnectionStateEstablished )
-        {
-            if( conn->consuming_connection_id == aConnectionId )
-            {
-                return conn;
-            }
-        }
-
-        conn = conn->next;
-    }
-
-    return NULL;
+    return by_consuming_id.Find( EipUint32( aConnectionId ), isEstablished );
 }
 
 
@@ -886,11 +949,20 @@ void AddNewActiveConnection( CipConn* aConn )
 
     g_active_connection_list = aConn;
     g_active_connection_list->state = kConnectionStateEstablished;
+
+    by_consuming_id.Insert( aConn );
+    by_triad.Insert( aConn );
+
+    timer_queue.Insert( aConn, kConnTimerWatchdog );
+    timer_queue.Insert( aConn, kConnTimerTransmission );
 }
 
 
 void RemoveFromActiveConnections( CipConn* aConn )
 {
+    // its sockets are closed or handed over, do not send on them anymore
+    ProductionBatchRemove( aConn );
+
 #if defined(DEBUG) || 1
     if( aConn->transport_trigger.Class() == kConnectionTransportClass1 )
     {
@@ -913,6 +985,12 @@ void RemoveFromActiveConnections( CipConn* aConn )
         aConn->next->prev = aConn->prev;
     }
 
+    by_consuming_id.Remove( aConn );
+    by_triad.Remove( aConn );
+
+    timer_queue.Remove( aConn, kConnTimerWatchdog );
+    timer_queue.Remove( aConn, kConnTimerTransmission );
+
     aConn->prev  = NULL;
     aConn->next  = NULL;
     aConn->state = kConnectionStateNonExistent;
@@ -966,12 +1044,15 @@ EipStatus TriggerConnections( int aOutputAssembly, int aInputAssembly )
             if( conn->transport_trigger.Trigger() == kConnectionTriggerTypeApplication )
             {
                 // produce at the next allowed occurrence
-                conn->transmission_trigger_timer_usecs = conn->production_inhibit_timer_usecs;
+                conn->SetTransmissionDeadlineUSecs( std::max( ConnectionTimeUSecs(),
+                        conn->production_inhibit_deadline_usecs ) );
                 nRetVal = kEipStatusOk;
             }
 
             break;
         }
+
+        conn = conn->next;
     }
 
     return nRetVal;
@@ -1083,16 +1164,28 @@ static EipStatus forward_open_common( CipInstance* instance,
 
     dummy.t_to_o_RPI_usecs = in.get32();
 
-    // The requested packet interval parameter needs to be a multiple of
-    // kOpenerTimerTickInMicroSeconds from the header file
-    EipUint32 temp = dummy.t_to_o_RPI_usecs % kOpenerTimerTickInMicroSeconds;
-
-    // round up to slower nearest integer multiple of our timer.
-    if( temp )
+    if( deadline_driven )
     {
-        dummy.t_to_o_RPI_usecs = (EipUint32) ( dummy.t_to_o_RPI_usecs / kOpenerTimerTickInMicroSeconds )
-            * kOpenerTimerTickInMicroSeconds + kOpenerTimerTickInMicroSeconds;
+        // Production is scheduled at its own deadline, so the RPI is
+        // honoured as requested down to kOpenerMinRpiInMicroSeconds.
+        if( dummy.t_to_o_RPI_usecs < kOpenerMinRpiInMicroSeconds )
+            dummy.t_to_o_RPI_usecs = kOpenerMinRpiInMicroSeconds;
     }
+    else
+    {
+        // The requested packet interval parameter needs to be a multiple of
+        // kOpenerTimerTickInMicroSeconds from the header file
+        EipUint32 temp = dummy.t_to_o_RPI_usecs % kOpenerTimerTickInMicroSeconds;
+
+        // round up to slower nearest integer multiple of our timer.
+        if( temp )
+        {
+            dummy.t_to_o_RPI_usecs = (EipUint32) ( dummy.t_to_o_RPI_usecs / kOpenerTimerTickInMicroSeconds )
+                * kOpenerTimerTickInMicroSeconds + kOpenerTimerTickInMicroSeconds;
+        }
+    }
+
+    // The granted t_to_o RPI is returned as the T->O API in the reply.
 
     if( isLarge )
         dummy.t_to_o_ncp.SetLarge( in.get32() );
@@ -1232,28 +1325,18 @@ static EipStatus forward_close_service( CipInstance* instance,
 
     CIPSTER_TRACE_INFO( "ForwardClose: ConnSerNo %d\n", connection_serial_number );
 
-    CipConn* active = g_active_connection_list;
+    // This state check should not be necessary as only established connections
+    // should be in the active connection list
+    CipConn* active = by_triad.Find( triadKey( connection_serial_number,
+                        originator_vendor_id, originator_serial_number ),
+                        isEstablishedOrTimedOut );
 
-    while( active )
+    if( active )
     {
-        // This check should not be necessary as only established connections
-        // should be in the active connection list
-        if( active->state == kConnectionStateEstablished ||
-            active->state == kConnectionStateTimedOut )
-        {
-            if( active->connection_serial_number == connection_serial_number
-             && active->originator_vendor_id     == originator_vendor_id
-             && active->originator_serial_number == originator_serial_number )
-            {
-                // found the corresponding connection object -> close it
-                CIPSTER_ASSERT( active->connection_close_function );
-                active->connection_close_function( active );
-                connection_status = kConnectionManagerStatusCodeSuccess;
-                break;
-            }
-        }
-
-        active = active->next;
+        // found the corresponding connection object -> close it
+        CIPSTER_ASSERT( active->connection_close_function );
+        active->connection_close_function( active );
+        connection_status = kConnectionManagerStatusCodeSuccess;
     }
 
     BufWriter out = response->data;
@@ -113,6 +113,21 @@ void AddNewActiveConnection( CipConn* aConn );
 // TODO: Missing documentation
 void RemoveFromActiveConnections( CipConn* aConn );
 
+/**
+ * Function ConnectionTimeUSecs
+ * returns the time base of the connection timers in usecs.  It is advanced
+ * by ManageConnections() and only meaningful relative to itself.
+ */
+EipUint64 ConnectionTimeUSecs();
+
+/**
+ * Function RescheduleConnectionTimer
+ * must be called after aConn->deadline_usecs[aKind] changed.  A deadline
+ * moved later costs nothing here, the queue notices it when the old
+ * deadline comes due.  Connections not in the active list are ignored.
+ */
+void RescheduleConnectionTimer( CipConn* aConn, ConnTimerKind aKind );
+
 /// @brief External globals needed from connectionmanager.c
 extern CipConn* g_active_connection_list;
 
@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+#ifndef CIPSTER_CIPCONNINDEX_H_
+#define CIPSTER_CIPCONNINDEX_H_
+
+#include <vector>
+
+#include "typedefs.h"
+#include "cipconnection.h"
+
+
+/**
+ * Class ConnIndex
+ * is an open addressing hash table (linear probing) over the connections in
+ * g_active_connection_list, keyed by a 64 bit value taken from each
+ * connection.  A key must not change while its connection is active.
+ * Keys need not be unique, Find() returns the first acceptable match.
+ */
+class ConnIndex
+{
+public:
+    typedef EipUint64   (*KeyFunc)( const CipConn* aConn );
+    typedef bool        (*AcceptFunc)( const CipConn* aConn );
+
+    ConnIndex( KeyFunc aKeyFunc ) :
+        key_func( aKeyFunc ),
+        count( 0 )
+    {}
+
+    void Insert( CipConn* aConn )
+    {
+        if( 2 * (count + 1) > slots.size() )
+            grow();
+
+        put( key_func( aConn ), aConn );
+        ++count;
+    }
+
+    void Remove( CipConn* aConn )
+    {
+        if( !count )
+            return;
+
+        unsigned mask = slots.size() - 1;
+        unsigned i    = hash( key_func( aConn ) ) & mask;
+
+        for( ; slots[i].conn; i = (i + 1) & mask )
+        {
+            if( slots[i].conn == aConn )
+            {
+                erase( i );
+                --count;
+                return;
+            }
+        }
+    }
+
+    CipConn* Find( EipUint64 aKey, AcceptFunc aAccept ) const
+    {
+        if( !count )
+            return NULL;
+
+        unsigned mask = slots.size() - 1;
+
+        for( unsigned i = hash( aKey ) & mask;  slots[i].conn;  i = (i + 1) & mask )
+        {
+            if( slots[i].key == aKey && aAccept( slots[i].conn ) )
+                return slots[i].conn;
+        }
+
+        return NULL;
+    }
+
+private:
+    struct Slot
+    {
+        Slot() : key( 0 ), conn( NULL ) {}
+
+        EipUint64   key;
+        CipConn*    conn;       ///< NULL when the slot is empty
+    };
+
+    static unsigned hash( EipUint64 aKey )
+    {
+        // Fibonacci hashing, the high bits are the well mixed ones.
+        return unsigned( (aKey * 0x9E3779B97F4A7C15ull) >> 32 );
+    }
+
+    void put( EipUint64 aKey, CipConn* aConn )
+    {
+        unsigned mask = slots.size() - 1;
+        unsigned i    = hash( aKey ) & mask;
+
+        while( slots[i].conn )
+            i = (i + 1) & mask;
+
+        slots[i].key  = aKey;
+        slots[i].conn = aConn;
+    }
+
+    /// Empty slot @a aHole, then shift back any later entries of its probe
+    /// run which would otherwise become unreachable.  No tombstones needed.
+    void erase( unsigned aHole )
+    {
+        unsigned mask = slots.size() - 1;
+        unsigned hole = aHole;
+
+        for( unsigned i = (hole + 1) & mask;  slots[i].conn;  i = (i + 1) & mask )
+        {
+            unsigned home = hash( slots[i].key ) & mask;
+
+            // move slot i into the hole if its home is not cyclically in (hole, i]
+            if( ((i - home) & mask) >= ((i - hole) & mask) )
+            {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+
+        slots[hole] = Slot();
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old;
+
+        old.swap( slots );
+        slots.resize( old.size() ? old.size() * 2 : 64 );
+
+        for( unsigned i = 0; i < old.size();  ++i )
+        {
+            if( old[i].conn )
+                put( old[i].key, old[i].conn );
+        }
+    }
+
+    KeyFunc             key_func;
+    unsigned            count;
+    std::vector<Slot>   slots;      ///< size is always a power of 2
+};
+
+#endif  // CIPSTER_CIPCONNINDEX_H_
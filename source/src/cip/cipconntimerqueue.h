@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+#ifndef CIPSTER_CIPCONNTIMERQUEUE_H_
+#define CIPSTER_CIPCONNTIMERQUEUE_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "typedefs.h"
+#include "cipconnection.h"
+
+
+/// A deadline which never comes due.
+const EipUint64 kConnTimerNever = ~EipUint64( 0 );
+
+
+/**
+ * Class ConnTimerQueue
+ * is an indexed binary min-heap holding the ConnTimerKind deadlines of the
+ * connections in g_active_connection_list, so a timer tick only touches
+ * connections with an expired timer.  Each entry knows its position through
+ * CipConn::timer_pos[], allowing removal in O(log n).
+ *
+ * The key of an entry is a lower bound of the connection's deadline.  A
+ * deadline moved later, such as the watchdog on every received packet, is
+ * not sifted: when the stale key comes due PopExpired() re-queues the entry
+ * under the actual deadline.  A deadline moved earlier is sifted up at once.
+ */
+class ConnTimerQueue
+{
+public:
+    void Insert( CipConn* aConn, ConnTimerKind aKind )
+    {
+        Entry e = { aConn->deadline_usecs[aKind], aConn, aKind };
+
+        heap.push_back( e );
+        aConn->timer_pos[aKind] = heap.size() - 1;
+        siftUp( heap.size() - 1 );
+    }
+
+    void Remove( CipConn* aConn, ConnTimerKind aKind )
+    {
+        int pos = aConn->timer_pos[aKind];
+
+        if( pos < 0 )
+            return;
+
+        int last = heap.size() - 1;
+
+        if( pos != last )
+        {
+            swap( pos, last );
+            heap.pop_back();
+
+            siftDown( pos );
+            siftUp( pos );
+        }
+        else
+            heap.pop_back();
+
+        aConn->timer_pos[aKind] = -1;
+    }
+
+    void Reschedule( CipConn* aConn, ConnTimerKind aKind )
+    {
+        int pos = aConn->timer_pos[aKind];
+
+        if( pos >= 0 && aConn->deadline_usecs[aKind] < heap[pos].key )
+        {
+            heap[pos].key = aConn->deadline_usecs[aKind];
+            siftUp( pos );
+        }
+    }
+
+    /**
+     * Function PopExpired
+     * finds the next timer whose deadline is at or before aNow and parks
+     * its entry at kConnTimerNever, the caller re-arms it through
+     * Reschedule().  Stale entries met on the way are re-queued.
+     *
+     * @return bool - true if one was found and put in aConn and aKind.
+     */
+    bool PopExpired( EipUint64 aNow, CipConn** aConn, ConnTimerKind* aKind )
+    {
+        while( heap.size() && heap[0].key <= aNow )
+        {
+            Entry& top = heap[0];
+
+            EipUint64 deadline = top.conn->deadline_usecs[top.kind];
+
+            *aConn = top.conn;
+            *aKind = top.kind;
+
+            if( deadline > aNow )
+            {
+                top.key = deadline;
+                siftDown( 0 );
+                continue;
+            }
+
+            top.key = kConnTimerNever;
+            siftDown( 0 );
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    struct Entry
+    {
+        EipUint64       key;
+        CipConn*        conn;
+        ConnTimerKind   kind;
+    };
+
+    void swap( int a, int b )
+    {
+        std::swap( heap[a], heap[b] );
+        heap[a].conn->timer_pos[heap[a].kind] = a;
+        heap[b].conn->timer_pos[heap[b].kind] = b;
+    }
+
+    void siftUp( int pos )
+    {
+        while( pos > 0 )
+        {
+            int parent = (pos - 1) / 2;
+
+            if( heap[parent].key <= heap[pos].key )
+                break;
+
+            swap( parent, pos );
+            pos = parent;
+        }
+    }
+
+    void siftDown( int pos )
+    {
+        int count = heap.size();
+
+        for(;;)
+        {
+            int least = pos;
+            int child = 2 * pos + 1;
+
+            if( child < count && heap[child].key < heap[least].key )
+                least = child;
+
+            if( child + 1 < count && heap[child + 1].key < heap[least].key )
+                least = child + 1;
+
+            if( least == pos )
+                break;
+
+            swap( pos, least );
+            pos = least;
+        }
+    }
+
+    std::vector<Entry>  heap;
+
+public:
+    /// Function NextDeadline returns the earliest key, kConnTimerNever if empty.
+    EipUint64 NextDeadline() const
+    {
+        return heap.size() ? heap[0].key : kConnTimerNever;
+    }
+};
+
+#endif  // CIPSTER_CIPCONNTIMERQUEUE_H_
@@ -45,7 +45,8 @@ CipAppPath& CipAppPath::operator = ( const CipAppPath& other )
 {
     pbits = other.pbits;
 
-    if( HasLogical() )
+    // a symbolic path may also carry a connection point and member ids
+    if( pbits & ~(1 << TAG) )
         memcpy( stuff, other.stuff, sizeof stuff );
 
     if( HasSymbol() )
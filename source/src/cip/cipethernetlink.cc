@@ -8,6 +8,7 @@
 
 #include "cipcommon.h"
 #include "cipmessagerouter.h"
+#include "ciptypedattribute.h"
 #include "ciperror.h"
 #include "byte_bufs.h"
 #include "cipster_api.h"
@@ -27,6 +28,8 @@ void ConfigureMacAddress( const EipUint8* mac_address )
 {
     memcpy( &g_ethernet_link.physical_address, mac_address,
             sizeof(g_ethernet_link.physical_address) );
+
+    InvalidateAttributeAllCaches( kCipEthernetLinkClassCode );
 }
 
 
@@ -36,10 +39,12 @@ static CipInstance* createEthernetLinkInstance()
 
     CipInstance* i = new CipInstance( clazz->Instances().size() + 1 );
 
-    i->AttributeInsert( 1, kCipUdint,  kGetableSingleAndAll, GetAttrData, NULL, &g_ethernet_link.interface_speed );
-    i->AttributeInsert( 2, kCipDword,  kGetableSingleAndAll, GetAttrData, NULL, &g_ethernet_link.interface_flags );
+    i->AttributeInsert( new TypedAttribute<EipUint32>( 1, kGetableSingleAndAll, &g_ethernet_link.interface_speed ) );
+    i->AttributeInsert( new TypedAttribute<EipUint32>( 2, kGetableSingleAndAll, &g_ethernet_link.interface_flags, kCipDword ) );
     i->AttributeInsert( 3, kCip6Usint, kGetableSingleAndAll, GetAttrData, NULL, &g_ethernet_link.physical_address );
 
+    i->CacheAttributeAll();
+
     clazz->InstanceInsert( i );
 
     return i;
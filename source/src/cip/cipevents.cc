@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include "cipevents.h"
+#include "trace.h"
+
+#if CIPSTER_EVENT_RING_SIZE
+
+#include <atomic>
+
+static_assert( ( CIPSTER_EVENT_RING_SIZE & ( CIPSTER_EVENT_RING_SIZE - 1 ) ) == 0,
+    "CIPSTER_EVENT_RING_SIZE must be a power of 2" );
+
+/*  A single producer, single consumer ring: only the stack's thread pushes
+    and moves head, only the application's thread pops and moves tail.  The
+    indices run freely and are masked on use, so head - tail is the fill.
+*/
+static CipsterEvent             ring[CIPSTER_EVENT_RING_SIZE];
+static std::atomic<unsigned>    head;
+static std::atomic<unsigned>    tail;
+static std::atomic<EipUint32>   overflows;
+
+
+/**
+ * Function pushEvent
+ * queues @a aEvent for the application, or counts it as lost if the ring is full.
+ */
+static void pushEvent( const CipsterEvent& aEvent )
+{
+    unsigned h = head.load( std::memory_order_relaxed );
+
+    if( h - tail.load( std::memory_order_acquire ) == CIPSTER_EVENT_RING_SIZE )
+    {
+        overflows.fetch_add( 1, std::memory_order_relaxed );
+        return;
+    }
+
+    ring[h & ( CIPSTER_EVENT_RING_SIZE - 1 )] = aEvent;
+
+    head.store( h + 1, std::memory_order_release );
+}
+
+
+bool PopCipsterEvent( CipsterEvent* aEvent )
+{
+    unsigned t = tail.load( std::memory_order_relaxed );
+
+    if( t == head.load( std::memory_order_acquire ) )
+        return false;
+
+    *aEvent = ring[t & ( CIPSTER_EVENT_RING_SIZE - 1 )];
+
+    tail.store( t + 1, std::memory_order_release );
+    return true;
+}
+
+
+EipUint32 CipsterEventOverflows()
+{
+    return overflows.load( std::memory_order_relaxed );
+}
+
+
+EipStatus NotifyAssemblyDataReceived( CipInstance* aInstance )
+{
+    CipsterEvent event;
+
+    event.type        = kCipsterEventAssemblyDataReceived;
+    event.io_event    = 0;
+    event.instance_id = aInstance->Id();
+    event.value       = 0;
+
+    pushEvent( event );
+    return kEipStatusOk;
+}
+
+
+void NotifyIoConnectionEvent( int aOutputAssemblyId, int aInputAssemblyId,
+        IoConnectionEvent aEvent )
+{
+    CipsterEvent event;
+
+    event.type        = kCipsterEventIoConnection;
+    event.io_event    = aEvent;
+    event.instance_id = aOutputAssemblyId;
+    event.value       = aInputAssemblyId;
+
+    pushEvent( event );
+}
+
+
+void NotifyRunIdleChanged( EipUint32 aRunIdle )
+{
+    CipsterEvent event;
+
+    event.type        = kCipsterEventRunIdleChanged;
+    event.io_event    = 0;
+    event.instance_id = 0;
+    event.value       = aRunIdle;
+
+    pushEvent( event );
+}
+
+#else
+
+bool PopCipsterEvent( CipsterEvent* aEvent )
+{
+    (void) aEvent;
+    return false;
+}
+
+
+EipUint32 CipsterEventOverflows()
+{
+    return 0;
+}
+
+
+EipStatus NotifyAssemblyDataReceived( CipInstance* aInstance )
+{
+    return AfterAssemblyDataReceived( aInstance );
+}
+
+
+void NotifyIoConnectionEvent( int aOutputAssemblyId, int aInputAssemblyId,
+        IoConnectionEvent aEvent )
+{
+    CheckIoConnectionEvent( aOutputAssemblyId, aInputAssemblyId, aEvent );
+}
+
+
+void NotifyRunIdleChanged( EipUint32 aRunIdle )
+{
+    RunIdleChanged( aRunIdle );
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+#ifndef CIPSTER_CIPEVENTS_H_
+#define CIPSTER_CIPEVENTS_H_
+
+#include "typedefs.h"
+#include "ciptypes.h"
+#include "cipster_api.h"
+
+/*  The stack tells the application about received data, I/O connection
+    changes and run/idle changes through these.  With CIPSTER_EVENT_RING_SIZE
+    they queue a CipsterEvent for PopCipsterEvent(), else they call the
+    application's callback directly.
+*/
+
+/**
+ * Function NotifyAssemblyDataReceived
+ * tells the application that @a aInstance received new I/O data, instead
+ * of AfterAssemblyDataReceived().
+ * @return EipStatus - the callback's verdict, always kEipStatusOk if queued.
+ */
+EipStatus NotifyAssemblyDataReceived( CipInstance* aInstance );
+
+/**
+ * Function NotifyIoConnectionEvent
+ * tells the application that an I/O connection was opened, timed out or
+ * closed, instead of CheckIoConnectionEvent().
+ */
+void NotifyIoConnectionEvent( int aOutputAssemblyId, int aInputAssemblyId,
+        IoConnectionEvent aEvent );
+
+/**
+ * Function NotifyRunIdleChanged
+ * tells the application the originator's new run/idle header, instead of
+ * RunIdleChanged().
+ */
+void NotifyRunIdleChanged( EipUint32 aRunIdle );
+
+#endif // CIPSTER_CIPEVENTS_H_
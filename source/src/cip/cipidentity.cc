@@ -29,6 +29,8 @@
 #include "cipidentity.h"
 #include "cipcommon.h"
 #include "cipmessagerouter.h"
+#include "ciptypedattribute.h"
+#include "encap.h"
 #include "ciperror.h"
 #include "byte_bufs.h"
 #include "cipster_api.h"
@@ -66,6 +68,9 @@ CipShortString product_name_ =
 void SetDeviceSerialNumber( EipUint32 serial_number )
 {
     serial_number_ = serial_number;
+
+    InvalidateAttributeAllCaches( kIdentityClassCode );
+    InvalidateListIdentityReply();
 }
 
 
@@ -75,6 +80,9 @@ void SetDeviceSerialNumber( EipUint32 serial_number )
 void SetDeviceStatus( EipUint16 status )
 {
     status_ = status;
+
+    InvalidateAttributeAllCaches( kIdentityClassCode );
+    InvalidateListIdentityReply();
 }
 
 
@@ -159,15 +167,18 @@ static CipInstance* createIdentityInstance()
 
     CipInstance* i = new CipInstance( clazz->Instances().size() + 1 );
 
-    i->AttributeInsert( 1, kCipUint, kGetableSingleAndAll, GetAttrData, NULL, &vendor_id_ );
-    i->AttributeInsert( 2, kCipUint, kGetableSingleAndAll, GetAttrData, NULL, &device_type_ );
-    i->AttributeInsert( 3, kCipUint, kGetableSingleAndAll, GetAttrData, NULL, &product_code_ );
-    i->AttributeInsert( 4, kCipUsintUsint, kGetableSingleAndAll, GetAttrData, NULL, &revision_ );
+    i->AttributeInsert( new TypedAttribute<EipUint16>( 1, kGetableSingleAndAll, &vendor_id_ ) );
+    i->AttributeInsert( new TypedAttribute<EipUint16>( 2, kGetableSingleAndAll, &device_type_ ) );
+    i->AttributeInsert( new TypedAttribute<EipUint16>( 3, kGetableSingleAndAll, &product_code_ ) );
+    i->AttributeInsert( new TypedAttribute<CipRevision>( 4, kGetableSingleAndAll, &revision_ ) );
+
+    i->AttributeInsert( new TypedAttribute<EipUint16>( 5, kGetableSingleAndAll, &status_, kCipWord ) );
+    i->AttributeInsert( new TypedAttribute<EipUint32>( 6, kGetableSingleAndAll, &serial_number_ ) );
 
-    i->AttributeInsert( 5, kCipWord, kGetableSingleAndAll, GetAttrData, NULL, &status_ );
-    i->AttributeInsert( 6, kCipUdint, kGetableSingleAndAll, GetAttrData, NULL, &serial_number_ );
+    i->AttributeInsert( new TypedAttribute<CipShortString>( 7, kGetableSingleAndAll, &product_name_ ) );
 
-    i->AttributeInsert( 7, kCipShortString, kGetableSingleAndAll, GetAttrData, NULL, &product_name_ );
+    // polled often by asset management tools, and changes only by the setters above
+    i->CacheAttributeAll();
 
     clazz->InstanceInsert( i );
 
@@ -5,6 +5,7 @@
  ******************************************************************************/
 
 #include <unordered_map>
+#include <stdexcept>
 #include <string.h>
 
 
@@ -21,6 +22,113 @@
 /// @brief Array of the available explicit connections
 static CipConn g_explicit_connections[CIPSTER_CIP_NUM_EXPLICIT_CONNS];
 
+
+#if CIPSTER_REQUEST_PATH_CACHE_SIZE
+
+/**
+ * Class CipRequestPathCache
+ * remembers what the last few requests of one explicit connection resolved
+ * to, keyed by their raw service code and request path bytes, so that a
+ * repeated request skips DeserializeMRR() and the class, instance and service
+ * lookups.  Entries are stale once CipClass::dispatch_generation moves on.
+ */
+class CipRequestPathCache
+{
+public:
+    struct Entry
+    {
+        unsigned        generation;
+        int             key_length;     ///< 0 when unused
+        EipByte         key[64];        ///< service, path word count, path
+        int             data_offset;    ///< where the service's data starts
+
+        CipAppPath      request_path;
+        CipClass*       clazz;
+        CipInstance*    instance;
+        CipService*     service;
+    };
+
+    CipRequestPathCache()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        for( int i = 0; i < CIPSTER_REQUEST_PATH_CACHE_SIZE; ++i )
+            entries[i].key_length = 0;
+
+        next = 0;
+    }
+
+    /// Return the length of the key at the front of aCommand, or 0 if too long
+    /// to be cached.
+    static int KeyLength( BufReader aCommand )
+    {
+        if( aCommand.size() < 2 )
+            return 0;
+
+        int length = 2 + aCommand.data()[1] * 2;
+
+        return length <= (int) sizeof( Entry().key ) &&
+               length <= (int) aCommand.size() ? length : 0;
+    }
+
+    const Entry* Find( BufReader aCommand ) const
+    {
+        int length = KeyLength( aCommand );
+
+        if( !length )
+            return NULL;
+
+        for( int i = 0; i < CIPSTER_REQUEST_PATH_CACHE_SIZE; ++i )
+        {
+            const Entry& e = entries[i];
+
+            if( e.key_length == length &&
+                e.generation == CipClass::dispatch_generation &&
+                !memcmp( e.key, aCommand.data(), length ) )
+            {
+                return &e;
+            }
+        }
+
+        return NULL;
+    }
+
+    void Store( BufReader aCommand, const CipMessageRouterRequest& aRequest,
+            CipClass* aClass, CipInstance* aInstance, CipService* aService )
+    {
+        int length = KeyLength( aCommand );
+
+        if( !length )
+            return;
+
+        Entry& e = entries[next];
+
+        next = (next + 1) % CIPSTER_REQUEST_PATH_CACHE_SIZE;
+
+        e.generation   = CipClass::dispatch_generation;
+        e.key_length   = length;
+        e.data_offset  = aRequest.data.data() - aCommand.data();
+        e.request_path = aRequest.request_path;
+        e.clazz        = aClass;
+        e.instance     = aInstance;
+        e.service      = aService;
+
+        memcpy( e.key, aCommand.data(), length );
+    }
+
+private:
+    Entry   entries[CIPSTER_REQUEST_PATH_CACHE_SIZE];
+    int     next;       ///< entry to replace next, round robin
+};
+
+/// One per explicit connection, same index as g_explicit_connections.
+static CipRequestPathCache g_request_path_caches[CIPSTER_CIP_NUM_EXPLICIT_CONNS];
+
+#endif
+
 /**
  * Class CipClassRegistry
  * is a container for the defined CipClass()es, which in turn hold all
@@ -35,6 +143,9 @@ class CipClassRegistry
 public:
     CipClass*   FindClass( int aClassId )
     {
+        if( by_id.Indexed() )
+            return by_id.Find( aClassId );
+
         ClassHash::iterator it = container.find( aClassId );
 
         if( it != container.end() )
@@ -54,11 +165,39 @@ public:
 
         std::pair< ClassHash::iterator, bool > r = container.insert( e );
 
+        if( r.second )
+        {
+            if( by_id.Frozen() )
+            {
+                aClass->FreezeDispatch();
+                index();
+            }
+
+            ++CipClass::dispatch_generation;
+        }
+
         return r.second;
     }
 
+    /**
+     * Function Freeze
+     * indexes every registered class by class id, and has each index its
+     * services, instances and attributes.  Classes registered later are
+     * indexed as they come.
+     */
+    void Freeze()
+    {
+        for( ClassHash::iterator it = container.begin(); it != container.end(); ++it )
+            it->second->FreezeDispatch();
+
+        index();
+    }
+
     void DeleteAll()
     {
+        by_id.Clear();
+        ++CipClass::dispatch_generation;
+
         while( container.size() )
         {
             delete container.begin()->second;       // Delete the first of remaining classes
@@ -73,7 +212,28 @@ public:
 
 private:
 
-    ClassHash   container;
+    // Covers the open and vendor specific class id ranges through 0x4ff.
+    static const int kClassIndexSpan = 0x500;
+
+    void index()
+    {
+        int highest = 0;
+
+        for( ClassHash::iterator it = container.begin(); it != container.end(); ++it )
+        {
+            if( it->first > highest )
+                highest = it->first;
+        }
+
+        if( by_id.Index( highest, container.size(), kClassIndexSpan ) )
+        {
+            for( ClassHash::iterator it = container.begin(); it != container.end(); ++it )
+                by_id.Put( it->first, it->second );
+        }
+    }
+
+    ClassHash               container;
+    CipIdTable<CipClass>    by_id;      ///< classes by class id, once frozen
 };
 
 
@@ -101,6 +261,12 @@ CipClass* GetCipClass( int class_id )
 }
 
 
+void FreezeCipDispatch()
+{
+    g_class_registry.Freeze();
+}
+
+
 
 //-----------------------------------------------------------------------------
 
@@ -146,6 +312,113 @@ int CipMessageRouterResponse::SerializeMRResponse( BufWriter aOutput )
 }
 
 
+/**
+ * Function multipleServicePacket
+ * is the Multiple Service Packet service of the Message Router, Vol1 2-4.8.
+ * Each embedded request, found by the offset table, goes through NotifyMR()
+ * like any other, and its reply is serialized straight into this reply behind
+ * the reply's own offset table.
+ */
+static EipStatus multipleServicePacket( CipInstance* instance,
+        CipMessageRouterRequest* request, CipMessageRouterResponse* response )
+{
+    // the largest reply header, with two words of additional status
+    const int kMaxReplyHeader = 4 + 2 * DIM( response->additional_status );
+
+    BufReader in = request->data;
+
+    if( in.size() < 2 )
+    {
+        response->general_status = kCipErrorNotEnoughData;
+        return kEipStatusOkSend;
+    }
+
+    unsigned count = in.get16();
+
+    if( !count || in.size() < 2 * count )
+    {
+        response->general_status = kCipErrorNotEnoughData;
+        return kEipStatusOkSend;
+    }
+
+    unsigned table_end = 2 + 2 * count;
+
+    if( response->data.size() < table_end )
+    {
+        response->general_status = kCipErrorReplyDataTooLarge;
+        return kEipStatusOkSend;
+    }
+
+    BufWriter   table( response->data.data(), table_end );
+    BufWriter   out = response->data + table_end;
+
+    table.put16( count );
+
+    for( unsigned i = 0;  i < count;  ++i )
+    {
+        unsigned start = BufReader( request->data.data() + 2 + 2 * i, 2 ).get16();
+        unsigned end   = i + 1 < count ?
+                            BufReader( request->data.data() + 4 + 2 * i, 2 ).get16() :
+                            request->data.size();
+
+        if( start < table_end || start >= end || end > request->data.size() )
+        {
+            CIPSTER_TRACE_WARN( "%s: bad offset of request %u\n", __func__, i );
+            response->general_status = kCipErrorInvalidParameter;
+            response->data_length = 0;
+            return kEipStatusOkSend;
+        }
+
+        if( out.size() < (size_t) kMaxReplyHeader )
+        {
+            response->general_status = kCipErrorReplyDataTooLarge;
+            response->data_length = 0;
+            return kEipStatusOkSend;
+        }
+
+        table.put16( out.data() - response->data.data() );
+
+        // the embedded reply's data goes behind room for its header
+        CipMessageRouterResponse embedded( response->CPFD() );
+
+        embedded.data = out + kMaxReplyHeader;
+
+        try
+        {
+            NotifyMR( BufReader( request->data.data() + start, end - start ), &embedded );
+        }
+        catch( const std::overflow_error& )
+        {
+            response->general_status = kCipErrorReplyDataTooLarge;
+            response->data_length = 0;
+            return kEipStatusOkSend;
+        }
+        catch( const std::range_error& )
+        {
+            // the embedded request was short
+            embedded.general_status = kCipErrorNotEnoughData;
+            embedded.data_length = 0;
+        }
+
+        if( embedded.general_status != kCipErrorSuccess )
+            response->general_status = kCipErrorEmbeddedServiceError;
+
+        EipByte header[kMaxReplyHeader];
+
+        int header_length = embedded.SerializeMRResponse( BufWriter( header, sizeof header ) );
+
+        memmove( out.data() + header_length, out.data() + kMaxReplyHeader, embedded.data_length );
+        memcpy( out.data(), header, header_length );
+
+        out += header_length + embedded.data_length;
+    }
+
+    response->data_length = out.data() - response->data.data();
+
+    return kEipStatusOkSend;
+}
+
+
 class CipMessageRouterClass : public CipClass
 {
 public:
@@ -171,6 +444,8 @@ CipMessageRouterClass::CipMessageRouterClass() :
     // Also, conformance test tool does not like SetAttributeSingle on this class,
     // delete the service which was established in CipClass constructor.
     delete ServiceRemove( kSetAttributeSingle );
+
+    ServiceInsert( kMultipleServicePacket, multipleServicePacket, "MultipleServicePacket" );
 }
 
 
@@ -215,6 +490,10 @@ CipError CipMessageRouterClass::OpenConnection( CipConn* aConn,
         explicit_connection->producing_connection_id = producing_connection_id_buffer;
         explicit_connection->instance_type = kConnInstanceTypeExplicit;
 
+#if CIPSTER_REQUEST_PATH_CACHE_SIZE
+        g_request_path_caches[explicit_connection - g_explicit_connections].Clear();
+#endif
+
         explicit_connection->consuming_socket = kEipInvalidSocket;
         explicit_connection->producing_socket = kEipInvalidSocket;
 
@@ -259,38 +538,40 @@ EipStatus CipMessageRouterInit()
 }
 
 
-EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse )
+/**
+ * Function resolveRequest
+ * parses aCommand into aRequest and finds the class, instance and service it
+ * is for.  Returns false with aResponse->general_status set if any is
+ * missing.
+ */
+static bool resolveRequest( BufReader aCommand, CipMessageRouterRequest* aRequest,
+        CipMessageRouterResponse* aResponse,
+        CipClass** aClass, CipInstance** aInstance, CipService** aService )
 {
-    CIPSTER_TRACE_INFO( "%s: routing unconnected message\n", __func__ );
+    int result = aRequest->DeserializeMRR( aCommand );
 
-    CipMessageRouterRequest request;
-
-    int result = request.DeserializeMRR( aCommand );
-
-    aResponse->reply_service = request.service;
+    aResponse->reply_service = aRequest->service;
 
     if( result <= 0 )
     {
         CIPSTER_TRACE_ERR( "notifyMR: error from createMRRequeststructure\n" );
         aResponse->general_status = kCipErrorPathSegmentError;
-        return kEipStatusOkSend;
+        return false;
     }
 
     CipClass* clazz = NULL;
 
     int instance_id;
 
-    if( request.request_path.HasSymbol() )
+    if( aRequest->request_path.HasSymbol() )
     {
         instance_id = 0;   // talk to class 06b instance 0
 
         // Per Rockwell Automation Publication 1756-PM020D-EN-P - June 2016:
         // Symbol Class Id is 0x6b.  Forward this request to that class.
-        // This class is not implemented in CIPster stack, but can be added by
-        // an application using simple RegisterCipClass( CipClass* aClass );
-        // Instances of this class are tags.
-        // I have such an implementation in my application.
-        clazz = GetCipClass( 0x6b );
+        // Instances of this class are tags, see cipsymbol.h.  Its services
+        // find the tag by name.
+        clazz = GetCipClass( kCipSymbolClassCode );
 
 #if 0
         // We cannot know the instance number without looking it up in the
@@ -302,10 +583,10 @@ EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse )
 #endif
 
     }
-    else if( request.request_path.HasInstance() )
+    else if( aRequest->request_path.HasInstance() )
     {
-        instance_id = request.request_path.GetInstance();
-        clazz = GetCipClass( request.request_path.GetClass() );
+        instance_id = aRequest->request_path.GetInstance();
+        clazz = GetCipClass( aRequest->request_path.GetClass() );
     }
     else
     {
@@ -313,7 +594,7 @@ EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse )
 
         // instance_id was not in the request
         aResponse->general_status = kCipErrorPathDestinationUnknown;
-        return kEipStatusOkSend;
+        return false;
     }
 
     if( !clazz )
@@ -321,13 +602,13 @@ EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse )
         CIPSTER_TRACE_ERR(
             "%s: unknown destination in request path:'%s'\n",
             __func__,
-            request.request_path.Format().c_str()
+            aRequest->request_path.Format().c_str()
             );
 
         // According to the test tool this should be the correct error flag
         // instead of CIP_ERROR_OBJECT_DOES_NOT_EXIST;
         aResponse->general_status = kCipErrorPathDestinationUnknown;
-        return kEipStatusOkSend;
+        return false;
     }
 
     CipInstance* instance = clazz->Instance( instance_id );
@@ -339,25 +620,79 @@ EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse )
         // According to the test tool this should be the correct error flag
         // instead of CIP_ERROR_OBJECT_DOES_NOT_EXIST;
         aResponse->general_status = kCipErrorPathDestinationUnknown;
-        return kEipStatusOkSend;
+        return false;
     }
 
-    CipService* service = clazz->Service( request.service );
+    CipService* service = clazz->Service( aRequest->service );
     if( !service )
     {
         CIPSTER_TRACE_WARN( "%s: service 0x%02x not found\n",
                 __func__,
-                request.service );
+                aRequest->service );
 
         // if no services or service not found, return an error reply
         aResponse->general_status = kCipErrorServiceNotSupported;
-        return kEipStatusOkSend;
+        return false;
+    }
+
+    *aClass    = clazz;
+    *aInstance = instance;
+    *aService  = service;
+
+    return true;
+}
+
+
+EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aResponse,
+        CipConn* aConn )
+{
+    CIPSTER_TRACE_INFO( "%s: routing unconnected message\n", __func__ );
+
+    CipMessageRouterRequest request;
+
+    CipClass*       clazz;
+    CipInstance*    instance;
+    CipService*     service;
+
+#if CIPSTER_REQUEST_PATH_CACHE_SIZE
+    CipRequestPathCache* cache = NULL;
+
+    if( aConn && aConn >= g_explicit_connections &&
+        aConn < g_explicit_connections + CIPSTER_CIP_NUM_EXPLICIT_CONNS )
+    {
+        cache = &g_request_path_caches[aConn - g_explicit_connections];
+    }
+
+    const CipRequestPathCache::Entry* hit = cache ? cache->Find( aCommand ) : NULL;
+
+    if( hit )
+    {
+        request.service      = hit->key[0];
+        request.request_path = hit->request_path;
+        request.data         = aCommand + hit->data_offset;
+
+        aResponse->reply_service = request.service;
+
+        clazz    = hit->clazz;
+        instance = hit->instance;
+        service  = hit->service;
+    }
+    else
+#endif
+    {
+        if( !resolveRequest( aCommand, &request, aResponse, &clazz, &instance, &service ) )
+            return kEipStatusOkSend;
+
+#if CIPSTER_REQUEST_PATH_CACHE_SIZE
+        if( cache )
+            cache->Store( aCommand, request, clazz, instance, service );
+#endif
     }
 
     CIPSTER_TRACE_INFO(
         "%s: targeting instance %d of class %s with service %s\n",
         __func__,
-        instance_id,
+        instance->Id(),
         instance->owning_class->ClassName().c_str(),
         service->ServiceName().c_str()
         );
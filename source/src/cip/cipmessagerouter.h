@@ -130,9 +130,13 @@ void DeleteAllClasses();
  *   CipMessageRouterResponse and its BufWriter 'data' and data_length.  This is
  *   how caller knows the length.  Should not advance data.data().
  *
+ * @param aConn is the explicit connection a connected message came in on,
+ *   whose request path cache is used, or NULL if unconnected.
+ *
  * @return EipStatus
  */
-EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aReply );
+EipStatus NotifyMR( BufReader aCommand, CipMessageRouterResponse* aReply,
+        CipConn* aConn = NULL );
 
 /**
  * Function RegisterCipClass
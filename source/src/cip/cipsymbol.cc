@@ -0,0 +1,482 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include "cipsymbol.h"
+#include "cipster_api.h"
+#include "cipcommon.h"
+#include "cipmessagerouter.h"
+#include "ciptypedattribute.h"
+#include "ciperror.h"
+#include "trace.h"
+
+
+static inline int lowerCase( int c )
+{
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+
+static bool sameName( const char* a, const char* b )
+{
+    while( *a && lowerCase( *a ) == lowerCase( *b ) )
+    {
+        ++a;
+        ++b;
+    }
+
+    return lowerCase( *a ) == lowerCase( *b );
+}
+
+
+//-----<CipSymbol>-------------------------------------------------------------
+
+CipSymbol::CipSymbol( int aInstanceId, const char* aName, EipUint8 aType,
+        void* aData, const int aDims[3] ) :
+    CipInstance( aInstanceId ),
+    hash( Hash( aName ) ),
+    name( aName ),
+    type( aType ),
+    element_size( TypeSize( aType ) ),
+    element_count( 1 ),
+    data( aData )
+{
+    for( int i = 0; i < 3; ++i )
+    {
+        dims[i] = aDims[i];
+
+        if( dims[i] )
+            element_count *= dims[i];
+    }
+
+    name_attr.length = name.size();
+    name_attr.string = (EipByte*) name.c_str();
+
+    AttributeInsert( new TypedAttribute<CipString>( 1, kGetableSingleAndAll, &name_attr ) );
+    AttributeInsert( new TypedAttribute<EipUint16>( 2, kGetableSingleAndAll, &type ) );
+}
+
+
+int CipSymbol::TypeSize( EipUint8 aType )
+{
+    switch( aType )
+    {
+    case kCipBool:
+    case kCipSint:
+    case kCipUsint:
+    case kCipByte:
+        return 1;
+
+    case kCipInt:
+    case kCipUint:
+    case kCipWord:
+        return 2;
+
+    case kCipDint:
+    case kCipUdint:
+    case kCipDword:
+    case kCipReal:
+        return 4;
+
+    case kCipLint:
+    case kCipUlint:
+    case kCipLword:
+    case kCipLreal:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+
+EipUint32 CipSymbol::Hash( const char* aName )
+{
+    EipUint32 h = 2166136261u;      // FNV-1a
+
+    while( *aName )
+    {
+        h ^= lowerCase( *aName++ );
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+int CipSymbol::ElementIndex( const CipAppPath& aPath ) const
+{
+    const int member[3] = { aPath.GetMember1(), aPath.GetMember2(), aPath.GetMember3() };
+
+    int index = 0;
+
+    for( int i = 0; i < 3; ++i )
+    {
+        if( !dims[i] )
+        {
+            // no such dimension, so no index for it either
+            if( member[i] )
+                return -1;
+
+            continue;
+        }
+
+        if( member[i] < 0 || member[i] >= dims[i] )
+            return -1;
+
+        index = index * dims[i] + member[i];
+    }
+
+    return index;
+}
+
+
+void CipSymbol::EncodeElements( int aFirst, int aCount, BufWriter& aOutput ) const
+{
+    const EipByte* p = (const EipByte*) data + aFirst * element_size;
+
+    switch( element_size )
+    {
+    case 1:
+        aOutput.append( p, aCount );
+        break;
+
+    case 2:
+        for( int i = 0; i < aCount; ++i )
+            aOutput.put16( ((const EipUint16*) p)[i] );
+        break;
+
+    case 4:
+        for( int i = 0; i < aCount; ++i )
+            aOutput.put32( ((const EipUint32*) p)[i] );
+        break;
+
+    case 8:
+        for( int i = 0; i < aCount; ++i )
+            aOutput.put64( ((const EipUint64*) p)[i] );
+        break;
+    }
+}
+
+
+void CipSymbol::DecodeElements( int aFirst, int aCount, BufReader& aInput )
+{
+    EipByte* p = (EipByte*) data + aFirst * element_size;
+
+    switch( element_size )
+    {
+    case 1:
+        for( int i = 0; i < aCount; ++i )
+            p[i] = *aInput++;
+        break;
+
+    case 2:
+        for( int i = 0; i < aCount; ++i )
+            ((EipUint16*) p)[i] = aInput.get16();
+        break;
+
+    case 4:
+        for( int i = 0; i < aCount; ++i )
+            ((EipUint32*) p)[i] = aInput.get32();
+        break;
+
+    case 8:
+        for( int i = 0; i < aCount; ++i )
+            ((EipUint64*) p)[i] = aInput.get64();
+        break;
+    }
+}
+
+
+//-----<CipSymbolClass>--------------------------------------------------------
+
+/**
+ * Function resolveSymbol
+ * returns the tag a Symbol class service is for: the instance itself when
+ * addressed logically, else the one named in the symbolic request path.
+ */
+static CipSymbol* resolveSymbol( CipInstance* instance, CipMessageRouterRequest* request )
+{
+    if( instance->Id() )
+        return static_cast<CipSymbol*>( instance );
+
+    if( !request->request_path.HasSymbol() )
+        return NULL;
+
+    CipSymbolClass* clazz = static_cast<CipSymbolClass*>( instance );
+
+    return clazz->Symbol( request->request_path.GetSymbol() );
+}
+
+
+/**
+ * Function readTag
+ * is the Read Tag service, 1756-PM020D-EN-P, and with kReadTagFragmented
+ * the Read Tag Fragmented service.  The request holds a UINT element count
+ * and for the latter a UDINT byte offset.  The reply holds the UINT tag type
+ * and that many elements starting at the one given by the request path, or
+ * with kReadTagFragmented the part of them from the byte offset on that fits
+ * the reply, with status kCipErrorPartialTransfer if more remain.  Elements
+ * are serialized straight from the tag, so only the reply buffer is used.
+ */
+static EipStatus readTag( CipInstance* instance,
+        CipMessageRouterRequest* request, CipMessageRouterResponse* response )
+{
+    CipSymbol* symbol = resolveSymbol( instance, request );
+
+    if( !symbol )
+    {
+        response->general_status = kCipErrorPathDestinationUnknown;
+        return kEipStatusOkSend;
+    }
+
+    int first = symbol->ElementIndex( request->request_path );
+
+    if( first < 0 )
+    {
+        response->general_status = kCipErrorPathDestinationUnknown;
+        return kEipStatusOkSend;
+    }
+
+    bool        fragmented = request->service == kReadTagFragmented;
+    BufReader   in = request->data;
+
+    if( in.size() < (fragmented ? 6u : 2u) )
+    {
+        response->general_status = kCipErrorNotEnoughData;
+        return kEipStatusOkSend;
+    }
+
+    int         count  = in.get16();
+    EipUint32   offset = fragmented ? in.get32() : 0;
+    int         size   = symbol->ElementSize();
+
+    if( count < 1 || first + count > symbol->ElementCount() ||
+        offset % size || offset >= EipUint32( count * size ) )
+    {
+        response->general_status = kCipErrorInvalidParameter;
+        return kEipStatusOkSend;
+    }
+
+    // whole elements only, behind the type
+    int room  = ( (int) response->data.size() - 2 ) / size;
+    int skip  = offset / size;
+    int slice = count - skip;
+
+    if( slice > room )
+    {
+        if( !fragmented || room < 1 )
+        {
+            response->general_status = kCipErrorReplyDataTooLarge;
+            return kEipStatusOkSend;
+        }
+
+        slice = room;
+        response->general_status = kCipErrorPartialTransfer;
+    }
+
+    BufWriter out = response->data;
+
+    out.put16( symbol->Type() );
+
+    symbol->EncodeElements( first + skip, slice, out );
+
+    response->data_length = out.data() - response->data.data();
+
+    return kEipStatusOkSend;
+}
+
+
+/**
+ * Function writeTag
+ * is the Write Tag service, 1756-PM020D-EN-P.  The request holds the UINT
+ * tag type, a UINT element count and that many elements, stored starting at
+ * the one given by the request path.
+ */
+static EipStatus writeTag( CipInstance* instance,
+        CipMessageRouterRequest* request, CipMessageRouterResponse* response )
+{
+    CipSymbol* symbol = resolveSymbol( instance, request );
+
+    if( !symbol )
+    {
+        response->general_status = kCipErrorPathDestinationUnknown;
+        return kEipStatusOkSend;
+    }
+
+    int first = symbol->ElementIndex( request->request_path );
+
+    if( first < 0 )
+    {
+        response->general_status = kCipErrorPathDestinationUnknown;
+        return kEipStatusOkSend;
+    }
+
+    BufReader in = request->data;
+
+    if( in.size() < 4 )
+    {
+        response->general_status = kCipErrorNotEnoughData;
+        return kEipStatusOkSend;
+    }
+
+    int type  = in.get16();
+    int count = in.get16();
+
+    if( type != symbol->Type() || count < 1 || first + count > symbol->ElementCount() )
+    {
+        response->general_status = kCipErrorInvalidParameter;
+        return kEipStatusOkSend;
+    }
+
+    size_t byte_count = count * symbol->ElementSize();
+
+    if( in.size() != byte_count )
+    {
+        response->general_status = in.size() < byte_count ?
+                kCipErrorNotEnoughData : kCipErrorTooMuchData;
+        return kEipStatusOkSend;
+    }
+
+    symbol->DecodeElements( first, count, in );
+
+    return kEipStatusOkSend;
+}
+
+
+CipSymbolClass::CipSymbolClass() :
+    CipClass( kCipSymbolClassCode,
+        "Symbol",
+        MASK2( 1, 2 ),          // common class attributes mask
+        0,                      // no class get_attribute_all service
+        0,                      // no instance get_attribute_all service
+        1                       // class revision
+        ),
+    symbol_count( 0 )
+{
+    // Tags are read only through Read Tag and written through Write Tag.
+    delete ServiceRemove( kSetAttributeSingle );
+    delete ServiceRemove( kSetAttributeList );
+
+    ServiceInsert( kReadTag, readTag, "ReadTag" );
+    ServiceInsert( kWriteTag, writeTag, "WriteTag" );
+    ServiceInsert( kReadTagFragmented, readTag, "ReadTagFragmented" );
+}
+
+
+void CipSymbolClass::rehash( unsigned aSize )
+{
+    std::vector<CipSymbol*> old;
+
+    old.swap( by_name );
+    by_name.resize( aSize, NULL );
+
+    for( unsigned i = 0; i < old.size(); ++i )
+    {
+        if( old[i] )
+        {
+            unsigned mask = aSize - 1;
+            unsigned j;
+
+            for( j = old[i]->hash & mask;  by_name[j];  j = (j + 1) & mask )
+                ;
+
+            by_name[j] = old[i];
+        }
+    }
+}
+
+
+bool CipSymbolClass::SymbolInsert( CipSymbol* aSymbol )
+{
+    if( Symbol( aSymbol->Name().c_str() ) )
+    {
+        CIPSTER_TRACE_ERR( "%s: tag '%s' already exists\n",
+            __func__, aSymbol->Name().c_str() );
+        return false;
+    }
+
+    if( !InstanceInsert( aSymbol ) )
+        return false;
+
+    // keep the load at most one half so that probe sequences stay short
+    if( 2 * (symbol_count + 1) > (int) by_name.size() )
+        rehash( by_name.size() ? 2 * by_name.size() : 16 );
+
+    unsigned mask = by_name.size() - 1;
+    unsigned j;
+
+    for( j = aSymbol->hash & mask;  by_name[j];  j = (j + 1) & mask )
+        ;
+
+    by_name[j] = aSymbol;
+    ++symbol_count;
+
+    return true;
+}
+
+
+CipSymbol* CipSymbolClass::Symbol( const char* aName ) const
+{
+    if( by_name.empty() )
+        return NULL;
+
+    EipUint32   h = CipSymbol::Hash( aName );
+    unsigned    mask = by_name.size() - 1;
+
+    for( unsigned j = h & mask;  by_name[j];  j = (j + 1) & mask )
+    {
+        CipSymbol* s = by_name[j];
+
+        if( s->hash == h && sameName( s->Name().c_str(), aName ) )
+            return s;
+    }
+
+    CIPSTER_TRACE_WARN( "%s: tag '%s' not found\n", __func__, aName );
+
+    return NULL;
+}
+
+
+CipInstance* CreateSymbolInstance( const char* aName, EipUint8 aType, void* aData,
+        int aDim1, int aDim2, int aDim3 )
+{
+    CipClass* found = GetCipClass( kCipSymbolClassCode );
+
+    // The first tag registers the built-in class.  A class 0x6b which the
+    // application registered itself is no CipSymbolClass and gets no tags.
+    if( !found )
+    {
+        found = new CipSymbolClass();
+        RegisterCipClass( found );
+    }
+
+    CipSymbolClass* clazz = dynamic_cast<CipSymbolClass*>( found );
+
+    const int dims[3] = { aDim1, aDim2, aDim3 };
+
+    if( !clazz || !CipSymbol::TypeSize( aType ) || !aData )
+    {
+        CIPSTER_TRACE_ERR( "%s: tag '%s' cannot be created\n", __func__, aName );
+        return NULL;
+    }
+
+    // an unused dimension may not precede a used one
+    if( (!aDim1 && aDim2) || (!aDim2 && aDim3) || aDim1 < 0 || aDim2 < 0 || aDim3 < 0 )
+    {
+        CIPSTER_TRACE_ERR( "%s: tag '%s' has bad dimensions\n", __func__, aName );
+        return NULL;
+    }
+
+    CipSymbol* symbol = new CipSymbol( clazz->Instances().size() + 1,
+                                aName, aType, aData, dims );
+
+    if( !clazz->SymbolInsert( symbol ) )
+    {
+        delete symbol;
+        return NULL;
+    }
+
+    return symbol;
+}
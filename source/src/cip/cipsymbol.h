@@ -0,0 +1,100 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+#ifndef CIPSTER_CIPSYMBOL_H_
+#define CIPSTER_CIPSYMBOL_H_
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "ciptypes.h"
+#include "cipepath.h"
+
+
+/**
+ * Class CipSymbol
+ * is one tag of the Symbol class 0x6b, an elementary typed scalar or array of
+ * up to three dimensions held in application storage.  Per Rockwell Automation
+ * Publication 1756-PM020D-EN-P the tag is addressed by name in a symbolic
+ * request path, and array elements by the member ids that follow it.
+ */
+class CipSymbol : public CipInstance
+{
+public:
+    CipSymbol( int aInstanceId, const char* aName, EipUint8 aType, void* aData,
+            const int aDims[3] );
+
+    const std::string& Name() const     { return name; }
+
+    EipUint16   Type() const            { return type; }
+    int         ElementSize() const     { return element_size; }
+    int         ElementCount() const    { return element_count; }
+
+    /**
+     * Function ElementIndex
+     * returns the index into this tag's elements of the one given by the
+     * member ids of @a aPath, missing trailing ones taken as 0, or -1 if
+     * that element does not exist.
+     */
+    int ElementIndex( const CipAppPath& aPath ) const;
+
+    /// Serialize aCount elements starting at aFirst, little endian.
+    void EncodeElements( int aFirst, int aCount, BufWriter& aOutput ) const;
+
+    /// Deserialize aCount elements starting at aFirst, little endian.
+    void DecodeElements( int aFirst, int aCount, BufReader& aInput );
+
+    /// Return the size in bytes of one element of aType, or 0 if aType is
+    /// not an elementary type a tag can have.
+    static int TypeSize( EipUint8 aType );
+
+    /// Return the hash of aName that the Symbol class files tags under,
+    /// which ignores case.
+    static EipUint32 Hash( const char* aName );
+
+    EipUint32   hash;                   ///< Hash( name )
+
+protected:
+    std::string name;
+    CipString   name_attr;              ///< attribute 1, pointing into name
+    EipUint16   type;                   ///< attribute 2
+    int         element_size;
+    int         element_count;
+    int         dims[3];                ///< 0 for each unused dimension
+    void*       data;                   ///< no ownership of data
+};
+
+
+/**
+ * Class CipSymbolClass
+ * is the Symbol class 0x6b.  Besides the instance id, it finds a tag by name
+ * in an open addressing hash table, so that a symbolic request path costs
+ * about what a logical one does.
+ */
+class CipSymbolClass : public CipClass
+{
+public:
+    CipSymbolClass();
+
+    /**
+     * Function SymbolInsert
+     * adds @a aSymbol as an instance and files it by name.
+     *
+     * @return bool - true on success, false if the name is taken, in which
+     *  case the caller keeps ownership of aSymbol.
+     */
+    bool SymbolInsert( CipSymbol* aSymbol );
+
+    /// Return the tag named aName, without regard to case, or NULL.
+    CipSymbol* Symbol( const char* aName ) const;
+
+private:
+    std::vector<CipSymbol*>     by_name;    ///< power of 2 size, NULL is empty
+    int                         symbol_count;
+
+    void rehash( unsigned aSize );
+};
+
+#endif  // CIPSTER_CIPSYMBOL_H_
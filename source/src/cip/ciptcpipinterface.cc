@@ -10,6 +10,8 @@
 #include "trace.h"
 #include "cipcommon.h"
 #include "cipmessagerouter.h"
+#include "ciptypedattribute.h"
+#include "encap.h"
 #include "ciperror.h"
 #include "byte_bufs.h"
 #include "cipethernetlink.h"
@@ -158,6 +160,9 @@ EipStatus ConfigureNetworkInterface( const char* ip_address,
     g_multicast_configuration.starting_multicast_address = htonl(
             ntohl( inet_addr( "239.192.1.0" ) ) + (host_id << 5) );
 
+    InvalidateAttributeAllCaches( kCipTcpIpInterfaceClassCode );
+    InvalidateListIdentityReply();
+
     return kEipStatusOk;
 }
 
@@ -185,6 +190,8 @@ void ConfigureDomainName( const char* domain_name )
     {
         interface_configuration_.domain_name.string = NULL;
     }
+
+    InvalidateAttributeAllCaches( kCipTcpIpInterfaceClassCode );
 }
 
 
@@ -211,6 +218,8 @@ void ConfigureHostName( const char* hostname )
     {
         hostname_.string = NULL;
     }
+
+    InvalidateAttributeAllCaches( kCipTcpIpInterfaceClassCode );
 }
 
 
@@ -220,27 +229,31 @@ static CipInstance* createTcpIpInterfaceInstance()
 
     CipInstance* i = new CipInstance( clazz->Instances().size() + 1 );
 
-    i->AttributeInsert( 1, kCipDword, kGetableSingleAndAll, &tcp_status_ );
-    i->AttributeInsert( 2, kCipDword, kGetableSingleAndAll, &configuration_capability_ );
+    i->AttributeInsert( new TypedAttribute<CipDword>( 1, kGetableSingleAndAll, &tcp_status_, kCipDword ) );
+    i->AttributeInsert( new TypedAttribute<CipDword>( 2, kGetableSingleAndAll, &configuration_capability_, kCipDword ) );
 
-    i->AttributeInsert( 3, kCipDword, kGetableSingleAndAll, &configuration_control_ );
+    i->AttributeInsert( new TypedAttribute<CipDword>( 3, kGetableSingleAndAll, &configuration_control_, kCipDword ) );
 
     i->AttributeInsert( 4, kCipAny, kGetableSingleAndAll, get_attr_4, NULL );
 
     i->AttributeInsert( 5, kCipUdintUdintUdintUdintUdintString, kGetableSingleAndAll, &interface_configuration_ );
 
-    i->AttributeInsert( 6, kCipString, kGetableSingleAndAll, &hostname_ );
+    i->AttributeInsert( new TypedAttribute<CipString>( 6, kGetableSingleAndAll, &hostname_ ) );
 
     i->AttributeInsert( 7, kCipAny, kGetableSingleAndAll, get_attr_7, NULL );
 
     // This is settable also, but volatile after setting.  To make it NV, supply
-    // a setter which calls SetAttrData() and then writes it to NV memory.
-    i->AttributeInsert( 8, kCipUsint, kSetAndGetAble, &g_time_to_live_value );
+    // a setter which calls TypedAttribute<EipUint8>::set() and then writes it
+    // to NV memory.
+    i->AttributeInsert( new TypedAttribute<EipUint8>( 8, kSetAndGetAble, &g_time_to_live_value ) );
 
     i->AttributeInsert( 9, kCipAny, kGetableSingleAndAll, get_multicast_config, NULL, &g_multicast_configuration );
 
     i->AttributeInsert( 13, kCipAny, kSetable, NULL, set_attr_13 );
 
+    // changes only by the Configure*() functions above and the Set services
+    i->CacheAttributeAll();
+
     clazz->InstanceInsert( i );
 
     return i;
@@ -0,0 +1,339 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+#ifndef CIPSTER_CIPTYPEDATTRIBUTE_H_
+#define CIPSTER_CIPTYPEDATTRIBUTE_H_
+
+#include <stdexcept>
+#include <string.h>
+
+#include "typedefs.h"
+#include "ciptypes.h"
+#include "cipmessagerouter.h"
+
+
+/**
+ * Struct CipCodec
+ * serializes one C++ type to and from its CIP wire form, little endian.
+ * The codec is picked at compile time from the C++ type, rather than by the
+ * runtime switch in EncodeData() and DecodeData().  Each specialization also
+ * gives the CIP type code its C++ type has unless told otherwise, since for
+ * example a UINT and a WORD are both held in an EipUint16.
+ */
+template< class T >
+struct CipCodec;
+
+
+template<>
+struct CipCodec<EipUint8>
+{
+    static const EipUint8 cip_type = kCipUsint;
+
+    static void Encode( EipUint8 aValue, BufWriter& aOutput )   { aOutput.put8( aValue ); }
+    static void Decode( EipUint8& aValue, BufReader& aInput )   { aValue = aInput.get8(); }
+};
+
+
+template<>
+struct CipCodec<EipInt8>
+{
+    static const EipUint8 cip_type = kCipSint;
+
+    static void Encode( EipInt8 aValue, BufWriter& aOutput )    { aOutput.put8( aValue ); }
+    static void Decode( EipInt8& aValue, BufReader& aInput )    { aValue = aInput.get8(); }
+};
+
+
+template<>
+struct CipCodec<EipUint16>
+{
+    static const EipUint8 cip_type = kCipUint;
+
+    static void Encode( EipUint16 aValue, BufWriter& aOutput )  { aOutput.put16( aValue ); }
+    static void Decode( EipUint16& aValue, BufReader& aInput )  { aValue = aInput.get16(); }
+};
+
+
+template<>
+struct CipCodec<EipInt16>
+{
+    static const EipUint8 cip_type = kCipInt;
+
+    static void Encode( EipInt16 aValue, BufWriter& aOutput )   { aOutput.put16( aValue ); }
+    static void Decode( EipInt16& aValue, BufReader& aInput )   { aValue = aInput.get16(); }
+};
+
+
+template<>
+struct CipCodec<EipUint32>
+{
+    static const EipUint8 cip_type = kCipUdint;
+
+    static void Encode( EipUint32 aValue, BufWriter& aOutput )  { aOutput.put32( aValue ); }
+    static void Decode( EipUint32& aValue, BufReader& aInput )  { aValue = aInput.get32(); }
+};
+
+
+template<>
+struct CipCodec<EipInt32>
+{
+    static const EipUint8 cip_type = kCipDint;
+
+    static void Encode( EipInt32 aValue, BufWriter& aOutput )   { aOutput.put32( aValue ); }
+    static void Decode( EipInt32& aValue, BufReader& aInput )   { aValue = aInput.get32(); }
+};
+
+
+template<>
+struct CipCodec<EipUint64>
+{
+    static const EipUint8 cip_type = kCipUlint;
+
+    static void Encode( EipUint64 aValue, BufWriter& aOutput )  { aOutput.put64( aValue ); }
+    static void Decode( EipUint64& aValue, BufReader& aInput )  { aValue = aInput.get64(); }
+};
+
+
+template<>
+struct CipCodec<EipInt64>
+{
+    static const EipUint8 cip_type = kCipLint;
+
+    static void Encode( EipInt64 aValue, BufWriter& aOutput )   { aOutput.put64( aValue ); }
+    static void Decode( EipInt64& aValue, BufReader& aInput )   { aValue = aInput.get64(); }
+};
+
+
+template<>
+struct CipCodec<EipFloat>
+{
+    static const EipUint8 cip_type = kCipReal;
+
+    static void Encode( EipFloat aValue, BufWriter& aOutput )   { aOutput.put_float( aValue ); }
+    static void Decode( EipFloat& aValue, BufReader& aInput )   { aValue = aInput.get_float(); }
+};
+
+
+template<>
+struct CipCodec<EipDfloat>
+{
+    static const EipUint8 cip_type = kCipLreal;
+
+    static void Encode( EipDfloat aValue, BufWriter& aOutput )  { aOutput.put_double( aValue ); }
+    static void Decode( EipDfloat& aValue, BufReader& aInput )  { aValue = aInput.get_double(); }
+};
+
+
+template<>
+struct CipCodec<CipRevision>
+{
+    static const EipUint8 cip_type = kCipUsintUsint;
+
+    static void Encode( const CipRevision& aValue, BufWriter& aOutput )
+    {
+        aOutput.put8( aValue.major_revision );
+        aOutput.put8( aValue.minor_revision );
+    }
+
+    static void Decode( CipRevision& aValue, BufReader& aInput )
+    {
+        aValue.major_revision = aInput.get8();
+        aValue.minor_revision = aInput.get8();
+    }
+};
+
+
+template<>
+struct CipCodec<CipDateAndTime>
+{
+    static const EipUint8 cip_type = kCipDateAndTime;
+
+    static void Encode( const CipDateAndTime& aValue, BufWriter& aOutput )
+    {
+        aOutput.put32( aValue.time_of_day );
+        aOutput.put16( aValue.date );
+    }
+
+    static void Decode( CipDateAndTime& aValue, BufReader& aInput )
+    {
+        aValue.time_of_day = aInput.get32();
+        aValue.date        = aInput.get16();
+    }
+};
+
+
+template<>
+struct CipCodec<CipShortString>
+{
+    static const EipUint8 cip_type = kCipShortString;
+
+    static void Encode( const CipShortString& aValue, BufWriter& aOutput )
+    {
+        aOutput.put8( aValue.length );
+        aOutput.append( aValue.string, aValue.length );
+    }
+
+    // points the string into aInput's buffer, nothing is copied
+    static void Decode( CipShortString& aValue, BufReader& aInput )
+    {
+        EipUint8        length = aInput.get8();
+        const EipByte*  src = aInput.data();
+
+        aInput += length;       // throws if short
+
+        aValue.string = (EipByte*) src;
+        aValue.length = length;
+    }
+};
+
+
+template<>
+struct CipCodec<CipString>
+{
+    static const EipUint8 cip_type = kCipString;
+
+    static void Encode( const CipString& aValue, BufWriter& aOutput )
+    {
+        aOutput.put16( aValue.length );
+        aOutput.append( aValue.string, aValue.length );
+
+        if( aValue.length & 1 )
+            aOutput.put8( 0 );      // pad to even byte count
+    }
+
+    // points the string into aInput's buffer, nothing is copied
+    static void Decode( CipString& aValue, BufReader& aInput )
+    {
+        EipUint16       length = aInput.get16();
+        const EipByte*  src = aInput.data();
+
+        aInput += length + (length & 1);    // throws if short, skips the pad
+
+        aValue.string = (EipByte*) src;
+        aValue.length = length;
+    }
+};
+
+
+/**
+ * Function StoreValue
+ * copies a value decoded by a CipCodec into where an attribute keeps it.
+ * A decoded string still points into the request, so its bytes are copied
+ * into the attribute's own buffer of aCapacity bytes, which the attribute's
+ * string pointer keeps.
+ *
+ * @return bool - false if the value does not fit, then aDst is untouched.
+ */
+template< class T >
+inline bool StoreValue( T* aDst, const T& aSrc, unsigned aCapacity )
+{
+    *aDst = aSrc;
+    return true;
+}
+
+inline bool StoreValue( CipShortString* aDst, const CipShortString& aSrc, unsigned aCapacity )
+{
+    if( aSrc.length > aCapacity )
+        return false;
+
+    memcpy( aDst->string, aSrc.string, aSrc.length );
+    aDst->length = aSrc.length;
+    return true;
+}
+
+inline bool StoreValue( CipString* aDst, const CipString& aSrc, unsigned aCapacity )
+{
+    if( aSrc.length > aCapacity )
+        return false;
+
+    memcpy( aDst->string, aSrc.string, aSrc.length );
+    aDst->length = aSrc.length;
+    return true;
+}
+
+
+/**
+ * Class TypedAttribute
+ * is a CipAttribute whose data is a T, with a getter and setter generated
+ * from CipCodec<T>.  Each goes straight to the BufWriter or BufReader calls
+ * for T, inlined to plain stores and loads when BYTEBUFS_INLINE is set, where
+ * GetAttrData() and SetAttrData() go through the type switch of EncodeData()
+ * and DecodeData().  Those stay the fallback for attributes of application
+ * defined types.
+ */
+template< class T >
+class TypedAttribute : public CipAttribute
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param aData is where the attribute's value lives, not owned.
+     * @param aType is the CIP type code, needed only when it is not the
+     *  default one of T, say kCipWord for an EipUint16.
+     * @param aCapacity is for string types only, the bytes of room at
+     *  aData->string.  set() refuses longer strings, so with 0 only an
+     *  empty string can be set.
+     */
+    TypedAttribute( int aAttributeId, EipUint8 aFlags, T* aData,
+            EipUint8 aType = CipCodec<T>::cip_type, unsigned aCapacity = 0 ) :
+        CipAttribute( aAttributeId, aType, aFlags, get, set, aData ),
+        capacity( aCapacity )
+    {}
+
+    /// Return the attribute's value.
+    T& Value() const    { return *(T*) data; }
+
+    /// The getter, serializes the value with CipCodec<T>::Encode().
+    static EipStatus get( CipAttribute* aAttribute,
+            CipMessageRouterRequest* aRequest,
+            CipMessageRouterResponse* aResponse )
+    {
+        BufWriter out = aResponse->data;    // copy so response->data is not advanced
+
+        CipCodec<T>::Encode( *(const T*) aAttribute->data, out );
+
+        aResponse->data_length = out.data() - aResponse->data.data();
+        return kEipStatusOkSend;
+    }
+
+    /// The setter, deserializes the value with CipCodec<T>::Decode().  The
+    /// value is left alone if the request holds too little or too much data,
+    /// or a string longer than the capacity, and general_status tells which.
+    static EipStatus set( CipAttribute* aAttribute,
+            CipMessageRouterRequest* aRequest,
+            CipMessageRouterResponse* aResponse )
+    {
+        BufReader   in = aRequest->data;
+        T           value = T();
+
+        try
+        {
+            CipCodec<T>::Decode( value, in );
+        }
+        catch( const std::range_error& )
+        {
+            aResponse->general_status = kCipErrorNotEnoughData;
+            return kEipStatusOkSend;
+        }
+
+        if( in.size() )
+        {
+            aResponse->general_status = kCipErrorTooMuchData;
+            return kEipStatusOkSend;
+        }
+
+        TypedAttribute* attr = static_cast<TypedAttribute*>( aAttribute );
+
+        if( !StoreValue( &attr->Value(), value, attr->capacity ) )
+            aResponse->general_status = kCipErrorTooMuchData;
+
+        return kEipStatusOkSend;
+    }
+
+protected:
+    unsigned    capacity;   ///< bytes of room at a string's buffer
+};
+
+#endif  // CIPSTER_CIPTYPEDATTRIBUTE_H_
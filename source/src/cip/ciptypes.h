@@ -25,6 +25,7 @@ enum ClassIds
     kCipAssemblyClassCode = 0x04,
     kConnectionClassId = 0x05,
     kCipConnectionManagerClassCode = 0x06,
+    kCipSymbolClassCode = 0x6B,
     kCipTcpIpInterfaceClassCode = 0xF5,
     kCipEthernetLinkClassCode = 0xF6,
 };
@@ -157,7 +158,13 @@ enum CIPServiceCode
     kRemoveMember = 0x1B,
     kGroupSync = 0x1C,
 
+    // vendor specific services, 0x32 - 0x4a
+    kGetAttributeSingleFragmented = 0x32,
+
     // Start CIP class or instance specific services, probably should go in class specific area
+    kReadTag = 0x4C,
+    kWriteTag = 0x4D,
+    kReadTagFragmented = 0x52,  // of the Symbol class, same code as kUnconnectedSend
     kForwardClose = 0x4E,
     kUnconnectedSend = 0x52,
     kForwardOpen = 0x54,
@@ -221,6 +228,16 @@ struct CipRevision
 };
 
 
+/** @brief CIP DATE_AND_TIME, a TIME_OF_DAY followed by a DATE
+ *
+ */
+struct CipDateAndTime
+{
+    EipUint32   time_of_day;    ///< milliseconds since midnight
+    EipUint16   date;           ///< days since 1972-01-01
+};
+
+
 class CipInstance;
 class CipAttribute;
 class CipClass;
@@ -259,6 +276,70 @@ EipStatus   SetAttrData( CipAttribute* attr, CipMessageRouterRequest* request,
                 CipMessageRouterResponse* response );
 
 
+/**
+ * Class CipIdTable
+ * is an index by id into a container of T*, so that once FreezeCipDispatch()
+ * has filled it in, a lookup is one bounds check and one load.  Before that,
+ * or when the ids are too sparse to be worth a slot each, it holds nothing and
+ * the container falls back to its own search.  Once frozen, the container
+ * re-indexes upon every insert and remove.
+ */
+template< class T >
+class CipIdTable
+{
+public:
+    CipIdTable() :
+        frozen( false )
+    {}
+
+    bool Frozen() const     { return frozen; }
+
+    /// Return true if Find() alone answers lookups.
+    bool Indexed() const    { return !slots.empty(); }
+
+    T* Find( int aId ) const
+    {
+        return (unsigned) aId < slots.size() ? slots[aId] : NULL;
+    }
+
+    /**
+     * Function Index
+     * freezes this table and makes room for the aCount members of a container
+     * whose highest id is aHighestId, if that takes no more than aMinSpan slots
+     * or four slots per member.
+     *
+     * @return bool - true if the caller is to Put() each member, else false
+     *  if the container is to be searched instead.
+     */
+    bool Index( int aHighestId, int aCount, int aMinSpan )
+    {
+        unsigned span = aHighestId + 1;
+        unsigned limit = aMinSpan > 4 * aCount ? aMinSpan : 4 * aCount;
+
+        frozen = true;
+        slots.clear();
+
+        if( !aCount || span > limit )
+            return false;
+
+        slots.resize( span, NULL );
+        return true;
+    }
+
+    void Put( int aId, T* aMember )     { slots[aId] = aMember; }
+
+    void Clear()
+    {
+        frozen = false;
+        slots.clear();
+    }
+
+private:
+    bool            frozen;
+    std::vector<T*> slots;
+};
+
+
 /**
  * Class CipAttribute
  * holds info for a CIP attribute which may be contained by a #CipInstance
@@ -323,6 +404,9 @@ public:
             return SetAttrData( this, request, response );
     }
 
+    /// Return the getter which Get() calls.
+    AttributeFunc Getter() const        { return getter ? getter : GetAttrData; }
+
 protected:
 
     CipInstance*    owning_instance;
@@ -347,6 +431,8 @@ protected:
  */
 class CipInstance
 {
+    friend class CipClass;
+
 public:
     typedef std::vector<CipAttribute*>      CipAttributes;
 
@@ -395,6 +481,36 @@ public:
         return attributes;
     }
 
+    /**
+     * Function CacheAttributeAll
+     * lets GetAttributeAll() keep the body of its reply for this instance and
+     * answer later requests with a copy of it.  Only for an instance whose
+     * attribute values change through SetAttributeSingle(), SetAttributeList()
+     * or functions which call InvalidateAttributeAll() after changing them.
+     */
+    void CacheAttributeAll()        { get_all_cacheable = true; }
+
+    /// Drop the cached GetAttributeAll() reply body, if any, after a change
+    /// to an attribute value.
+    void InvalidateAttributeAll()   { get_all_cached = false; }
+
+    /// Return the cached GetAttributeAll() reply body, or NULL if none.
+    const std::vector<EipByte>* CachedAttributeAll() const
+    {
+        return get_all_cached ? &get_all_cache : NULL;
+    }
+
+    /// Keep aBody as the GetAttributeAll() reply body, if CacheAttributeAll()
+    /// was called.
+    void SetCachedAttributeAll( const EipByte* aBody, int aLength )
+    {
+        if( get_all_cacheable )
+        {
+            get_all_cache.assign( aBody, aBody + aLength );
+            get_all_cached = true;
+        }
+    }
+
     int             instance_id;    ///< this instance's number (unique within the class)
     CipClass*       owning_class;   ///< class the instance belongs to or NULL if none.
 
@@ -403,6 +519,14 @@ public:
 protected:
     CipAttributes       attributes;     ///< sorted pointer array to CipAttribute, unique to this instance
 
+    CipIdTable<CipAttribute>    attribute_index;    ///< attributes by id, once frozen
+
+    bool                    get_all_cacheable;
+    bool                    get_all_cached;
+    std::vector<EipByte>    get_all_cache;      ///< GetAttributeAll() reply body
+
+    void indexAttributes();
+
     void ShowAttributes()
     {
         for( CipAttributes::const_iterator it = attributes.begin();
@@ -599,12 +723,24 @@ public:
     EipUint32   get_attribute_all_mask;     /**< mask indicating which attributes are
                                               *  returned by getAttributeAll*/
 
+    /// Bumped whenever a class is registered or an instance or service is
+    /// inserted or removed, which makes any cached lookup result stale.
+    static unsigned dispatch_generation;
+
     /**
      * Function FindUniqueFreeId
      * returns the first unused instance Id.
      */
     int FindUniqueFreeId() const;
 
+    /**
+     * Function FreezeDispatch
+     * indexes the services, instances and attributes of this class and its
+     * meta-class by id, so that Service(), Instance() and Attribute() need no
+     * search.  Called by FreezeCipDispatch().
+     */
+    void FreezeDispatch();
+
     /**
      * Function OpenConnection
      * should be overridden in derived classes which DO handle open connections.
@@ -649,6 +785,12 @@ protected:
     CipInstances    instances;              ///< collection of instances
     CipServices     services;               ///< collection of services
 
+    CipIdTable<CipInstance> instance_index; ///< instances by id, once frozen
+    CipIdTable<CipService>  service_index;  ///< services by id, once frozen
+
+    void indexInstances();
+    void indexServices();
+
     void ShowServices()
     {
         for( CipServices::const_iterator it = services.begin();
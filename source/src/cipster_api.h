@@ -109,6 +109,16 @@ CipClass* GetCipClass( int class_id );
  */
 EipStatus RegisterCipClass( CipClass* aClass );
 
+/** @ingroup CIP_API
+ * @brief Index all registered classes, and their instances, services and
+ *  attributes, by id so that routing an explicit request takes no searching.
+ *
+ * Call this once after ApplicationInitialization().  Classes, instances,
+ * services and attributes may still be added or removed afterwards, and are
+ * indexed as that happens.
+ */
+void FreezeCipDispatch();
+
 
 /** @ingroup CIP_API
  * @brief Serialize aDataType according to CIP encoding into aBuf
@@ -153,6 +163,78 @@ int DecodeData( int aDataType, void* cip_data, BufReader& aBuf );
  */
 CipInstance* CreateAssemblyInstance( int aInstanceId, BufWriter aBuffer );
 
+/**
+ * Enum AssemblySnapshotWriter
+ * tells which side fills a snapshot assembly, the other side only reads it.
+ */
+enum AssemblySnapshotWriter
+{
+    kAssemblyWrittenByApplication,  ///< e.g. an input assembly, produced by the stack
+    kAssemblyWrittenByStack,        ///< e.g. an output or configuration assembly
+};
+
+/** @ingroup CIP_API
+ * @brief Create an instance of an assembly object whose data may be written
+ * or read by application threads other than the one running the stack.
+ *
+ * The stack allocates three buffers of @a aByteCount bytes for it.  The
+ * writer fills one, then publishes it by an atomic index swap, and the
+ * reader always sees the whole of the newest image it picked up.  Neither
+ * side waits for the other, and the stack never sends a torn image.
+ *
+ * For kAssemblyWrittenByApplication the application fills
+ * AssemblyWriteBuffer() and calls AssemblyPublish(), for
+ * kAssemblyWrittenByStack it calls AssemblyLatestData().
+ *
+ * @param aInstanceId  instance number of the assembly object to create
+ * @param aByteCount   size of the assembly data
+ * @param aWriter      which side fills the data
+ * @return CipInstance* - the instance of the created assembly object or NULL on error.
+ */
+CipInstance* CreateSnapshotAssemblyInstance( int aInstanceId, int aByteCount,
+        AssemblySnapshotWriter aWriter );
+
+/** @ingroup CIP_API
+ * @brief Return the buffer the application fills next for a snapshot
+ * assembly written by the application.  It holds an older image, so all of
+ * it has to be written before AssemblyPublish().
+ */
+EipByte* AssemblyWriteBuffer( CipInstance* aInstance );
+
+/** @ingroup CIP_API
+ * @brief Make the filled AssemblyWriteBuffer() the newest image of the
+ * assembly, as sent by the stack from its next production on.
+ */
+void AssemblyPublish( CipInstance* aInstance );
+
+/** @ingroup CIP_API
+ * @brief Return the newest complete image of a snapshot assembly written by
+ * the stack.  The image stays unchanged until the next call from the same
+ * application thread, which must be the only one reading this assembly.
+ */
+const EipByte* AssemblyLatestData( CipInstance* aInstance );
+
+/** @ingroup CIP_API
+ * @brief Create a tag in the Symbol class 0x6b, which clients read and write
+ * by name with the Read Tag and Write Tag services.  Tags larger than a reply
+ * are read in parts with Read Tag Fragmented.
+ *
+ * The first call registers the built-in Symbol class.  An application which
+ * registers its own class 0x6b instead must not call this, it then returns NULL.
+ *
+ * @param aName        tag name, up to 40 characters, matched without regard to case
+ * @param aType        elementary type of the tag, e.g. kCipDint or kCipReal
+ * @param aData        the application's storage for all elements of the tag, which
+ *                     the stack reads and writes in place and does not own.
+ * @param aDim1        first array dimension, or 0 for a scalar
+ * @param aDim2        second array dimension, or 0
+ * @param aDim3        third array dimension, or 0
+ * @return CipInstance* - the tag's instance or NULL if the name is taken or
+ *  aType is not elementary.
+ */
+CipInstance* CreateSymbolInstance( const char* aName, EipUint8 aType, void* aData,
+        int aDim1 = 0, int aDim2 = 0, int aDim3 = 0 );
+
 class CipConn;
 
 /** @ingroup CIP_API
@@ -283,6 +365,25 @@ int HandleReceivedExplictUdpData( int socket, const sockaddr_in* from_address,
  */
 EipStatus HandleReceivedConnectedData( const sockaddr_in* from_address, BufReader aCommand );
 
+/// The bytes of a class 0/1 packet in front of its connection size worth of
+/// data: item count, sequenced address item and data item header.
+#define CIPSTER_IO_PACKET_HEADER_SIZE   (2 + 4+8 + 4)
+
+/// The size of a buffer which can receive any class 0/1 packet: the largest
+/// payload plus the packet header, sequence count and run/idle header.
+#define CIPSTER_IO_PACKET_SIZE_MAX  (CIPSTER_IO_DATA_SIZE_MAX + CIPSTER_IO_PACKET_HEADER_SIZE + 2 + 4)
+
+/** @ingroup CIP_API
+ * @brief Return the size of the longest class 0/1 packet which a connection
+ * opened so far consumes, from its negotiated O->T connection size.  Never
+ * more than CIPSTER_IO_PACKET_SIZE_MAX.
+ *
+ * The consuming sockets of point to point connections share one port, so
+ * any of them may receive the packets of any connection.  A network handler
+ * sizes its receive buffer by this rather than by the largest size possible.
+ */
+int ConsumedPacketSizeMax();
+
 /** @ingroup CIP_API
  * @brief Check if any of the connection timers (TransmissionTrigger or
  * WatchdogTimeout) have timed out.
@@ -295,6 +396,25 @@ EipStatus HandleReceivedConnectedData( const sockaddr_in* from_address, BufReade
  */
 EipStatus ManageConnections();
 
+/** @ingroup CIP_API
+ * @brief Expire the connection timers by their absolute deadlines rather
+ * than by CIPSTER_TIMER_TICK.
+ *
+ * The first call switches CIPster to deadline driven timers: from then on
+ * ManageConnections() only does its other periodic work, and the RPI of a
+ * new I/O connection is no longer rounded up to a multiple of the tick, but
+ * only limited to kOpenerMinRpiInMicroSeconds.  Call it whenever convenient,
+ * but at the latest at the deadline it returned last.
+ *
+ * Delayed replies to broadcast ListIdentity requests go out from here too,
+ * and are among the deadlines returned.
+ *
+ * @param aNowUSecs is a monotonic time in usecs.
+ * @return EipUint64 - the earliest pending deadline on the same clock, which
+ *  may be early but never late; ~0 if there is none.
+ */
+EipUint64 ManageConnectionTimers( EipUint64 aNowUSecs );
+
 /** @ingroup CIP_API
  * @brief Trigger the production of an application triggered connection.
  *
@@ -474,6 +594,50 @@ void CipFree( void* data );
  */
 void RunIdleChanged( EipUint32 run_idle_value );
 
+/**
+ * Enum CipsterEventType
+ * tells what a CipsterEvent reports.
+ */
+enum CipsterEventType
+{
+    kCipsterEventAssemblyDataReceived,  ///< assembly instance_id received I/O data
+    kCipsterEventIoConnection,          ///< io_event for output assembly instance_id, input assembly value
+    kCipsterEventRunIdleChanged,        ///< the originator's run/idle header is now value
+};
+
+/**
+ * Struct CipsterEvent
+ * is one record of the event ring, see PopCipsterEvent().
+ */
+struct CipsterEvent
+{
+    EipUint8    type;           ///< a CipsterEventType
+    EipUint8    io_event;       ///< an IoConnectionEvent for kCipsterEventIoConnection
+    EipUint16   instance_id;
+    EipUint32   value;
+};
+
+/** @ingroup CIP_API
+ * @brief Take the oldest event the stack has queued for the application.
+ *
+ * With CIPSTER_EVENT_RING_SIZE configured the stack does not call
+ * AfterAssemblyDataReceived() for I/O data, CheckIoConnectionEvent() or
+ * RunIdleChanged(), but queues a CipsterEvent in a ring of that size
+ * instead.  The application drains it from one thread of its own, without
+ * locking, and the stack's I/O does not wait for the application.
+ * AfterAssemblyDataReceived() is still called for configuration data and
+ * explicit Set requests, whose reply depends on its verdict.
+ *
+ * @param aEvent where to put the event
+ * @return bool - false if there is no event, or no ring configured.
+ */
+bool PopCipsterEvent( CipsterEvent* aEvent );
+
+/** @ingroup CIP_API
+ * @brief Return the count of events lost so far because the ring was full.
+ */
+EipUint32 CipsterEventOverflows();
+
 /** @ingroup CIP_CALLBACK_API
  * @brief create a producing or consuming UDP socket
  *
@@ -503,6 +667,35 @@ int CreateUdpSocket( UdpCommuncationDirection communication_direction,
  */
 EipStatus SendUdpData( struct sockaddr_in* socket_data, int socket, BufReader aOutput );
 
+/** @ingroup CIP_CALLBACK_API
+ * @brief One UDP datagram within a SendUdpDataBatch() call
+ *
+ * The datagram is @a header followed by @a data, to be gathered by the
+ * platform, e.g. with an iovec per part.  For produced I/O data the header
+ * is the CPF and @a data refers straight to the assembly's attribute 3.
+ */
+struct UdpSendItem
+{
+    struct sockaddr_in* address;    ///< "send to" address
+    int                 socket;     ///< socket descriptor to send on
+    BufReader           header;     ///< first part of the datagram
+    BufReader           data;       ///< second part of the datagram, may be empty
+    EipStatus           result;     ///< set by SendUdpDataBatch()
+};
+
+/** @ingroup CIP_CALLBACK_API
+ * @brief send several UDP datagrams at once, used for all the I/O data
+ *  produced in one timer tick.
+ *
+ * Items having the same socket are adjacent in @a aItems, so the platform
+ * may send each such group using a single system call.
+ *
+ * @param aItems the datagrams, for each the result is to be set to
+ *  kEipStatusOk or kEipStatusError.
+ * @param aCount number of items in @a aItems
+ */
+void SendUdpDataBatch( UdpSendItem* aItems, int aCount );
+
 /** @ingroup CIP_CALLBACK_API
  * @brief Close the given socket and clean up the stack
  *
@@ -611,7 +804,8 @@ void IApp_CloseSocket_tcp( int socket_handle );
  *      CIP object or Assembly object instances. See the module @ref CIP_API
  *      for available functions. Currently no functions are available to
  *      remove any created objects or instances. This is planned
- *      for future versions.
+ *      for future versions.  Then call FreezeCipDispatch() so that requests
+ *      are routed by table lookups.
  *   -# Setup the listening TCP and UDP port:\n
  *      THE ETHERNET/IP SPECIFICATION demands from devices to listen to TCP
  *      connections and UDP datagrams on the port AF12hex for explicit messages.
@@ -684,6 +878,13 @@ void IApp_CloseSocket_tcp( int socket_handle );
  *   - void InsertService(S_CIP_Class *class, EIP_UINT8 service_number,
  * CipServiceFunction service_function, char *service_name);
  *
+ * Every instance of a class gets Get_Attribute_Single, Set_Attribute_Single,
+ * Get_Attribute_List and Set_Attribute_List, and Get_Attributes_All if the
+ * class has a mask for it.  It also gets the vendor specific service 0x32,
+ * kGetAttributeSingleFragmented, which reads an attribute too large for one
+ * reply from a byte offset.  A class whose own vendor service is 0x32
+ * replaces it by inserting that service, or drops it with ServiceRemove().
+ *
  * @page license CIPster Open Source License
  * The CIPster Open Source License is an adapted BSD style license. The
  * adaptations include the use of the term EtherNet/IP(TM) and the necessary
@@ -98,8 +98,8 @@ int NotifyConnectedCommonPacketFormat( BufReader aCommand, BufWriter aReply )
     if( conn )
     {
         // reset the watchdog timer
-        conn->inactivity_watchdog_timer_usecs =
-            conn->o_to_t_RPI_usecs << ( 2 + conn->connection_timeout_multiplier );
+        conn->SetWatchdogTimeoutUSecs(
+            conn->o_to_t_RPI_usecs << ( 2 + conn->connection_timeout_multiplier ) );
 
         // TODO check connection id  and sequence count
         if( cpfd.DataItemType() == kCipItemIdConnectedDataItem )
@@ -113,7 +113,7 @@ int NotifyConnectedCommonPacketFormat( BufReader aCommand, BufWriter aReply )
             CipMessageRouterResponse response( &cpfd );
 
             // command is advanced by 2 here
-            EipStatus s = NotifyMR( command, &response );
+            EipStatus s = NotifyMR( command, &response, conn );
 
             if( s != kEipStatusError )
             {
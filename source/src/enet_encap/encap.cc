@@ -5,6 +5,8 @@
  ******************************************************************************/
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <vector>
 #include "cipster_api.h"
 #include "cpf.h"
 #include "encap.h"
@@ -53,25 +55,35 @@ enum CapabilityFlags
 };
 
 
-/// According to EIP spec at least 2 delayed message requests should be supported
-#define ENCAP_NUMBER_OF_SUPPORTED_DELAYED_ENCAP_MESSAGES    2
-
 // currently we only have the size of an encapsulation message
 #define ENCAP_MAX_DELAYED_ENCAP_MESSAGE_SIZE   \
     ( ENCAPSULATION_HEADER_LENGTH + 39 + sizeof(CIPSTER_DEVICE_NAME) )
 
 
-struct DelayedMsg
+/**
+ * Struct DelayedReply
+ * is a ListIdentity reply to a broadcast request, waiting for its random
+ * delay to pass.  Only the request's encapsulation header is kept, the rest
+ * of the reply is the shared list_identity_reply, as of when it is sent.
+ */
+struct DelayedReply
 {
-    EipInt32    time_out_usecs;     // must be signed 32 bits
+    EipUint64   deadline_usecs;     ///< on the ConnectionTimeUSecs() clock
     int         socket;
     sockaddr_in receiver;
-    EipByte     message[ENCAP_MAX_DELAYED_ENCAP_MESSAGE_SIZE];
-    unsigned    message_size;
+    EipByte     header[ENCAPSULATION_HEADER_LENGTH];   ///< echoed back, length patched
+
+    /// Return a key identifying the tool this reply goes to.
+    EipUint64 ReceiverKey() const
+    {
+        return ( (EipUint64) receiver.sin_addr.s_addr << 16 ) | receiver.sin_port;
+    }
 
-    BufReader Payload() const
+    /// Order for the std heap functions, which keep the largest on top,
+    /// so that the earliest deadline is on top.
+    bool operator<( const DelayedReply& aOther ) const
     {
-        return BufReader( message, message_size );
+        return deadline_usecs > aOther.deadline_usecs;
     }
 };
 
@@ -107,7 +119,27 @@ public:
 
 static int g_registered_sessions[CIPSTER_NUMBER_OF_SUPPORTED_SESSIONS];
 
-static DelayedMsg g_delayed_messages[ENCAP_NUMBER_OF_SUPPORTED_DELAYED_ENCAP_MESSAGES];
+/// Pending delayed replies, a min-heap on deadline_usecs.
+static std::vector<DelayedReply>    delayed_replies;
+
+
+/**
+ * Function isReplyPending
+ * tells if delayed_replies already holds a reply for aReceiverKey, so that a
+ * tool repeating its broadcast before the reply went out gets only the one.
+ * The heap is at most CIPSTER_DELAYED_LIST_IDENTITY_MAX long, so a linear
+ * scan of it beats keeping a second, node based, index of its keys.
+ */
+static bool isReplyPending( EipUint64 aReceiverKey )
+{
+    for( unsigned i = 0; i < delayed_replies.size(); ++i )
+    {
+        if( delayed_replies[i].ReceiverKey() == aReceiverKey )
+            return true;
+    }
+
+    return false;
+}
 
 
 //   @brief Initializes session list and interface information.
@@ -123,10 +155,8 @@ void EncapsulationInit()
         g_registered_sessions[i] = kEipInvalidSocket;
     }
 
-    for( unsigned i = 0; i < ENCAP_NUMBER_OF_SUPPORTED_DELAYED_ENCAP_MESSAGES; i++ )
-    {
-        g_delayed_messages[i].socket = -1;
-    }
+    delayed_replies.clear();
+    delayed_replies.reserve( CIPSTER_DELAYED_LIST_IDENTITY_MAX );
 }
 
 
@@ -263,11 +293,20 @@ static EncapsulationProtocolErrorCode unregisterSession( CipUdint session_handle
 }
 
 
-static int encapsulateListIdentyResponseMessage( BufWriter aReply )
+/// The ListIdentity reply past the encapsulation header, serialized once
+/// from the identity and TCP/IP objects since every broadcast asks for it.
+static EipByte  list_identity_reply[ENCAP_MAX_DELAYED_ENCAP_MESSAGE_SIZE - ENCAPSULATION_HEADER_LENGTH];
+static int      list_identity_reply_size;   ///< 0 when it needs rebuilding
+
+
+void InvalidateListIdentityReply()
 {
-    if( aReply.size() < 40 )
-        return -1;
+    list_identity_reply_size = 0;
+}
 
+
+static int serializeListIdentity( BufWriter aReply )
+{
     BufWriter out = aReply;
 
     out.put16( 1 );       // Item count: one item
@@ -309,43 +348,60 @@ static int encapsulateListIdentyResponseMessage( BufWriter aReply )
 }
 
 
-static int handleReceivedListIdentityCommandImmediate( BufWriter aReply )
+/// Return the ListIdentity reply past the encapsulation header, rebuilt
+/// first if InvalidateListIdentityReply() was called since last time.
+static BufReader listIdentityReply()
 {
-    return encapsulateListIdentyResponseMessage( aReply );
+    if( !list_identity_reply_size )
+    {
+        list_identity_reply_size = serializeListIdentity(
+                BufWriter( list_identity_reply, sizeof list_identity_reply ) );
+    }
+
+    return BufReader( list_identity_reply, list_identity_reply_size );
 }
 
-static int handleReceivedListIdentityCommandDelayed( int socket, const sockaddr_in* from_address,
-        unsigned aMSecDelay, BufReader aCommand )
+
+static int encapsulateListIdentyResponseMessage( BufWriter aReply )
 {
-    DelayedMsg* delayed = NULL;
+    BufReader reply = listIdentityReply();
 
-    for( unsigned i = 0; i < ENCAP_NUMBER_OF_SUPPORTED_DELAYED_ENCAP_MESSAGES; i++ )
-    {
-        if( kEipInvalidSocket == g_delayed_messages[i].socket )
-        {
-            delayed = &g_delayed_messages[i];
-            break;
-        }
-    }
+    if( aReply.size() < reply.size() )
+        return -1;
 
-    if( delayed )
-    {
-        delayed->socket   = socket;
-        delayed->receiver = *from_address;
+    memcpy( aReply.data(), reply.data(), reply.size() );
 
-        delayed->time_out_usecs = aMSecDelay * 1000;
+    return reply.size();
+}
 
-        BufWriter out( delayed->message, sizeof delayed->message );
 
-        out.append( aCommand.data(), ENCAPSULATION_HEADER_LENGTH );
+static int handleReceivedListIdentityCommandImmediate( BufWriter aReply )
+{
+    return encapsulateListIdentyResponseMessage( aReply );
+}
 
-        delayed->message_size = encapsulateListIdentyResponseMessage( out );
+static int handleReceivedListIdentityCommandDelayed( int socket, const sockaddr_in* from_address,
+        unsigned aMSecDelay, BufReader aCommand )
+{
+    DelayedReply delayed;
 
-        BufWriter len( delayed->message + 2, 2 );
+    delayed.deadline_usecs = ConnectionTimeUSecs() + aMSecDelay * EipUint64( 1000 );
+    delayed.socket   = socket;
+    delayed.receiver = *from_address;
 
-        len.put16( delayed->message_size );
+    memcpy( delayed.header, aCommand.data(), ENCAPSULATION_HEADER_LENGTH );
 
-        delayed->message_size += ENCAPSULATION_HEADER_LENGTH;
+    // A repeated request keeps the reply already scheduled, and so its delay.
+    if( delayed_replies.size() < CIPSTER_DELAYED_LIST_IDENTITY_MAX &&
+        !isReplyPending( delayed.ReceiverKey() ) )
+    {
+        delayed_replies.push_back( delayed );
+        std::push_heap( delayed_replies.begin(), delayed_replies.end() );
+    }
+    else
+    {
+        CIPSTER_TRACE_INFO( "%s: not scheduling a reply, %u pending\n",
+            __func__, (unsigned) delayed_replies.size() );
     }
 
     return 0;
@@ -371,12 +427,16 @@ static int handleReceivedListInterfacesCommand( BufWriter aReply )
  */
 static int handleReceivedListServicesCommand( BufWriter aReply )
 {
-    BufWriter out = aReply;
+    // constant, so serialized only upon the first request
+    static EipByte  reply[2 + 2 + 2 + 2 + 2 + 16];
+    static int      reply_size;
 
-    static const EipByte name_of_service[16] = "Communications";
-
-    try
+    if( !reply_size )
     {
+        static const EipByte name_of_service[16] = "Communications";
+
+        BufWriter out( reply, sizeof reply );
+
         out.put16( 1 );
         out.put16( kCipItemIdListServiceResponse );
         out.put16( 20 );    // length of following command specific data is fixed
@@ -384,12 +444,15 @@ static int handleReceivedListServicesCommand( BufWriter aReply )
         out.put16( kCapabilityFlagsCipTcp | kCapabilityFlagsCipUdpClass0or1 ); // capability_flags
         out.append( name_of_service, 16 );
 
-        return out.data() - aReply.data();
+        reply_size = out.data() - reply;
     }
-    catch( std::exception e )
-    {
+
+    if( aReply.size() < (size_t) reply_size )
         return -1;
-    }
+
+    memcpy( aReply.data(), reply, reply_size );
+
+    return reply_size;
 }
 
 
@@ -672,23 +735,47 @@ void EncapsulationShutDown()
 }
 
 
-void ManageEncapsulationMessages()
+EipUint64 ManageEncapsulationMessages()
 {
-    for( unsigned i = 0; i < ENCAP_NUMBER_OF_SUPPORTED_DELAYED_ENCAP_MESSAGES; i++ )
+    static std::vector<DelayedReply>    due;
+    static std::vector<UdpSendItem>     items;
+
+    EipUint64 now = ConnectionTimeUSecs();
+
+    while( delayed_replies.size() && delayed_replies.front().deadline_usecs <= now )
+    {
+        std::pop_heap( delayed_replies.begin(), delayed_replies.end() );
+
+        due.push_back( delayed_replies.back() );
+        delayed_replies.pop_back();
+    }
+
+    if( due.size() )
     {
-        if( kEipInvalidSocket != g_delayed_messages[i].socket )
+        BufReader reply = listIdentityReply();
+
+        for( unsigned i = 0; i < due.size();  ++i )
         {
-            g_delayed_messages[i].time_out_usecs -= kOpenerTimerTickInMicroSeconds;
+            BufWriter len( due[i].header + 2, 2 );
 
-            if( g_delayed_messages[i].time_out_usecs < 0 )
-            {
-                // If delay is reached or passed, send the UDP message
-                SendUdpData( &g_delayed_messages[i].receiver,
-                        g_delayed_messages[i].socket,
-                        g_delayed_messages[i].Payload() );
+            len.put16( reply.size() );
 
-                g_delayed_messages[i].socket = -1;
-            }
+            UdpSendItem item;
+
+            item.address = &due[i].receiver;
+            item.socket  = due[i].socket;
+            item.header  = BufReader( due[i].header, ENCAPSULATION_HEADER_LENGTH );
+            item.data    = reply;
+            item.result  = kEipStatusOk;
+
+            items.push_back( item );
         }
+
+        SendUdpDataBatch( &items[0], items.size() );
+
+        items.clear();
+        due.clear();
     }
+
+    return delayed_replies.size() ? delayed_replies.front().deadline_usecs : ~EipUint64( 0 );
 }
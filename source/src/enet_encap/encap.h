@@ -23,6 +23,9 @@
 //* @brief Ethernet/IP standard port
 static const int kOpenerEthernetPort = 0xAF12;
 
+//* @brief The port to be used per default for I/O messages on UDP
+static const int kOpenerEipIoUdpPort = 2222;   // = 0x08AE;
+
 /** @brief definition of status codes in encapsulation protocol
  * All other codes are either legacy codes, or reserved for future use
  *
@@ -58,10 +61,21 @@ void EncapsulationShutDown();
  * @brief Handle delayed encapsulation message responses
  *
  * Certain encapsulation message requests require a delayed sending of the response
- * message. This functions checks if messages need to be sent and performs the
- * sending.
+ * message. This functions sends those due by ConnectionTimeUSecs(), in one
+ * SendUdpDataBatch() call.
+ *
+ * @return EipUint64 - the deadline of the next one on that clock, ~0 if none.
+ */
+EipUint64 ManageEncapsulationMessages();
+
+/** @ingroup ENCAP
+ * @brief Drop the pre-serialized ListIdentity reply
+ *
+ * The reply is serialized once and copied into every ListIdentity response
+ * after that.  Call this after changing a value it holds, i.e. the identity
+ * status or serial number, or the IP address, so the next one rebuilds it.
  */
-void ManageEncapsulationMessages();
+void InvalidateListIdentityReply();
 
 
 #endif // CIPSTER_ENCAP_H_
@@ -0,0 +1,12 @@
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "cipmessagerouter.h"
+
+IMPORT_TEST_GROUP(RandomClass);
+IMPORT_TEST_GROUP(XorShiftRandom);
+IMPORT_TEST_GROUP(ByteBufs);
+IMPORT_TEST_GROUP(ConnIndex);
+IMPORT_TEST_GROUP(ConnTimerQueue);
+IMPORT_TEST_GROUP(MultipleServicePacket);
+IMPORT_TEST_GROUP(TypedAttribute);
+IMPORT_TEST_GROUP(AssemblySnapshots);
@@ -1,5 +0,0 @@
-#include "CppUTest/CommandLineTestRunner.h"
-
-IMPORT_TEST_GROUP(RandomClass);
-IMPORT_TEST_GROUP(XorShiftRandom);
-IMPORT_TEST_GROUP(EndianConversion);
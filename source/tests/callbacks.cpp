@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+/*  The callbacks which cipster_api.h expects of the application and its
+    network handler, doing nothing, so the tests link without either.
+*/
+
+#include "cipster_api.h"
+
+
+void HandleApplication()
+{
+}
+
+
+void CheckIoConnectionEvent( int output_assembly_id, int input_assembly_id,
+        IoConnectionEvent io_connection_event )
+{
+}
+
+
+EipStatus AfterAssemblyDataReceived( CipInstance* instance )
+{
+    return kEipStatusOk;
+}
+
+
+bool BeforeAssemblyDataSend( CipInstance* aInstance )
+{
+    return false;
+}
+
+
+EipStatus ResetDevice()
+{
+    return kEipStatusOk;
+}
+
+
+EipStatus ResetDeviceToInitialConfiguration( bool also_reset_comm_parameters )
+{
+    return kEipStatusOk;
+}
+
+
+void RunIdleChanged( EipUint32 run_idle_value )
+{
+}
+
+
+int CreateUdpSocket( UdpCommuncationDirection communication_direction,
+        struct sockaddr_in* socket_data )
+{
+    return kEipInvalidSocket;
+}
+
+
+EipStatus SendUdpData( struct sockaddr_in* socket_data, int socket, BufReader aOutput )
+{
+    return kEipStatusOk;
+}
+
+
+void SendUdpDataBatch( UdpSendItem* aItems, int aCount )
+{
+    for( int i = 0; i < aCount;  ++i )
+        aItems[i].result = kEipStatusOk;
+}
+
+
+void CloseSocket( int socket )
+{
+}
+
+
+void IApp_CloseSocket_udp( int socket_handle )
+{
+}
+
+
+void IApp_CloseSocket_tcp( int socket_handle )
+{
+}
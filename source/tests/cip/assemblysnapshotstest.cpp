@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <thread>
+
+#include <CppUTest/TestHarness.h>
+
+#include "cipassembly.h"
+
+
+static const int kImageSize = 64;
+
+
+// Fills the writer's buffer with aValue and publishes it.
+static void publish( AssemblySnapshots& aSnapshots, EipByte aValue )
+{
+    memset( aSnapshots.Back(), aValue, kImageSize );
+    aSnapshots.Publish();
+}
+
+
+// Returns the byte every position of the reader's image holds, -1 if they differ.
+static int frontValue( const AssemblySnapshots& aSnapshots )
+{
+    const EipByte* image = aSnapshots.Front();
+
+    for( int i = 1; i < kImageSize;  ++i )
+    {
+        if( image[i] != image[0] )
+            return -1;
+    }
+
+    return image[0];
+}
+
+
+TEST_GROUP( AssemblySnapshots )
+{
+};
+
+
+TEST( AssemblySnapshots, AcquireTakesPublishedImageOnce )
+{
+    AssemblySnapshots   snapshots( kImageSize );
+
+    CHECK_FALSE( snapshots.Acquire() );
+    LONGS_EQUAL( 0, frontValue( snapshots ) );
+
+    publish( snapshots, 1 );
+
+    CHECK( snapshots.Acquire() );
+    LONGS_EQUAL( 1, frontValue( snapshots ) );
+
+    CHECK_FALSE( snapshots.Acquire() );
+    LONGS_EQUAL( 1, frontValue( snapshots ) );
+}
+
+
+TEST( AssemblySnapshots, NewestImageWins )
+{
+    AssemblySnapshots   snapshots( kImageSize );
+
+    publish( snapshots, 1 );
+    publish( snapshots, 2 );
+    publish( snapshots, 3 );
+
+    CHECK( snapshots.Acquire() );
+    LONGS_EQUAL( 3, frontValue( snapshots ) );
+}
+
+
+TEST( AssemblySnapshots, WriterNeverGetsReadersImage )
+{
+    AssemblySnapshots   snapshots( kImageSize );
+
+    for( int i = 1; i < 20;  ++i )
+    {
+        publish( snapshots, i );
+
+        if( i % 3 == 0 )
+            CHECK( snapshots.Acquire() );
+
+        CHECK( snapshots.Back() != snapshots.Front() );
+    }
+}
+
+
+TEST( AssemblySnapshots, ThreadsSeeWholeImagesInOrder )
+{
+    const int kLast = 200;
+
+    AssemblySnapshots   snapshots( kImageSize );
+
+    std::thread writer( [&snapshots]()
+        {
+            for( int i = 1; i <= kLast;  ++i )
+            {
+                publish( snapshots, i );
+                std::this_thread::yield();
+            }
+        } );
+
+    int last = 0;
+
+    while( last < kLast )
+    {
+        if( !snapshots.Acquire() )
+            continue;
+
+        int value = frontValue( snapshots );
+
+        // never torn, and never older than one seen before
+        CHECK( value > last );
+
+        if( value <= last )
+            break;
+
+        last = value;
+    }
+
+    writer.join();
+}
@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <CppUTest/TestHarness.h>
+
+#include "cipconnindex.h"
+
+
+static CipConn  conns[40];
+
+
+// Scrambled keys, since evenly spaced ones never share a probe run.
+static EipUint64 idKey( const CipConn* aConn )
+{
+    EipUint64 key = aConn->consuming_connection_id * 0xBF58476D1CE4E5B9ull;
+
+    return key ^ ( key >> 31 );
+}
+
+
+static bool anyConn( const CipConn* aConn )
+{
+    return true;
+}
+
+
+static bool isEstablished( const CipConn* aConn )
+{
+    return aConn->state == kConnectionStateEstablished;
+}
+
+
+TEST_GROUP( ConnIndex )
+{
+    void setup()
+    {
+        for( int i = 0; i < DIM( conns );  ++i )
+        {
+            conns[i].Clear();
+            conns[i].consuming_connection_id = 0x10000 + 7 * i;
+        }
+    }
+};
+
+
+TEST( ConnIndex, FindsEachInserted )
+{
+    ConnIndex index( idKey );
+
+    POINTERS_EQUAL( NULL, index.Find( 0x10000, anyConn ) );
+
+    for( int i = 0; i < DIM( conns );  ++i )
+        index.Insert( &conns[i] );
+
+    // 40 entries made the table grow past its first 64 slots
+    for( int i = 0; i < DIM( conns );  ++i )
+        POINTERS_EQUAL( &conns[i], index.Find( idKey( &conns[i] ), anyConn ) );
+
+    POINTERS_EQUAL( NULL, index.Find( 0x10001, anyConn ) );
+}
+
+
+TEST( ConnIndex, RemoveKeepsProbeRunsReachable )
+{
+    // 31 entries stay in the first 64 slots, with several probe runs.
+    const int kCount = 31;
+
+    // Remove in a scattered order, after each removal every entry still
+    // inserted must be found, which fails if erase() leaves a hole inside
+    // the probe run of another entry.
+    for( int stride = 1; stride < 8;  ++stride )
+    {
+        ConnIndex   index( idKey );
+        bool        present[kCount];
+
+        for( int i = 0; i < kCount;  ++i )
+        {
+            index.Insert( &conns[i] );
+            present[i] = true;
+        }
+
+        for( int n = 0, r = 0; n < kCount;  ++n, r = ( r + 3 * stride + 1 ) % kCount )
+        {
+            while( !present[r] )
+                r = ( r + 1 ) % kCount;
+
+            index.Remove( &conns[r] );
+            present[r] = false;
+
+            for( int i = 0; i < kCount;  ++i )
+            {
+                POINTERS_EQUAL( present[i] ? &conns[i] : NULL,
+                        index.Find( idKey( &conns[i] ), anyConn ) );
+            }
+        }
+    }
+}
+
+
+TEST( ConnIndex, RemoveOfAbsentIsHarmless )
+{
+    ConnIndex index( idKey );
+
+    index.Remove( &conns[0] );
+
+    index.Insert( &conns[1] );
+    index.Remove( &conns[0] );
+
+    POINTERS_EQUAL( &conns[1], index.Find( idKey( &conns[1] ), anyConn ) );
+}
+
+
+TEST( ConnIndex, DuplicateKeysAreFilteredByAccept )
+{
+    ConnIndex index( idKey );
+
+    conns[1].consuming_connection_id = conns[0].consuming_connection_id;
+    conns[1].state = kConnectionStateEstablished;
+
+    index.Insert( &conns[0] );
+    index.Insert( &conns[1] );
+
+    POINTERS_EQUAL( &conns[1], index.Find( idKey( &conns[0] ), isEstablished ) );
+
+    index.Remove( &conns[1] );
+
+    POINTERS_EQUAL( NULL, index.Find( idKey( &conns[0] ), isEstablished ) );
+    POINTERS_EQUAL( &conns[0], index.Find( idKey( &conns[0] ), anyConn ) );
+}
@@ -0,0 +1,194 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <CppUTest/TestHarness.h>
+
+#include "cipconntimerqueue.h"
+
+
+static CipConn  conns[16];
+
+
+// Pops every timer expired at aNow, re-arming none, and returns how many.
+static int popAll( ConnTimerQueue& aQueue, EipUint64 aNow,
+        CipConn** aOrder, ConnTimerKind* aKinds = NULL )
+{
+    CipConn*        conn;
+    ConnTimerKind   kind;
+    int             count = 0;
+
+    while( aQueue.PopExpired( aNow, &conn, &kind ) )
+    {
+        aOrder[count] = conn;
+
+        if( aKinds )
+            aKinds[count] = kind;
+
+        ++count;
+    }
+
+    return count;
+}
+
+
+TEST_GROUP( ConnTimerQueue )
+{
+    void setup()
+    {
+        for( int i = 0; i < DIM( conns );  ++i )
+        {
+            conns[i].Clear();
+
+            for( int k = 0; k < kConnTimerCount;  ++k )
+                conns[i].deadline_usecs[k] = kConnTimerNever;
+        }
+    }
+};
+
+
+TEST( ConnTimerQueue, PopsInDeadlineOrder )
+{
+    ConnTimerQueue  queue;
+    CipConn*        order[DIM( conns )];
+
+    CHECK( kConnTimerNever == queue.NextDeadline() );
+
+    // deadlines 1000, 3000, ... 31000 then 2000, 4000, ... 32000
+    for( int i = 0; i < DIM( conns );  ++i )
+    {
+        int j = i < 8 ? 2 * i : 2 * ( i - 8 ) + 1;
+
+        conns[j].deadline_usecs[kConnTimerWatchdog] = 1000 * ( j + 1 );
+        queue.Insert( &conns[j], kConnTimerWatchdog );
+    }
+
+    CHECK( 1000 == queue.NextDeadline() );
+
+    LONGS_EQUAL( 0, popAll( queue, 999, order ) );
+    LONGS_EQUAL( 5, popAll( queue, 5000, order ) );
+
+    for( int i = 0; i < 5;  ++i )
+        POINTERS_EQUAL( &conns[i], order[i] );
+
+    LONGS_EQUAL( DIM( conns ) - 5, popAll( queue, 100000, order ) );
+
+    for( int i = 0; i < DIM( conns ) - 5;  ++i )
+        POINTERS_EQUAL( &conns[i + 5], order[i] );
+
+    // popped entries are parked, not removed
+    CHECK( kConnTimerNever == queue.NextDeadline() );
+    LONGS_EQUAL( 0, popAll( queue, kConnTimerNever - 1, order ) );
+}
+
+
+TEST( ConnTimerQueue, KindsAreQueuedSeparately )
+{
+    ConnTimerQueue  queue;
+    CipConn*        order[2];
+    ConnTimerKind   kinds[2];
+
+    conns[0].deadline_usecs[kConnTimerWatchdog]     = 2000;
+    conns[0].deadline_usecs[kConnTimerTransmission] = 1000;
+
+    queue.Insert( &conns[0], kConnTimerWatchdog );
+    queue.Insert( &conns[0], kConnTimerTransmission );
+
+    LONGS_EQUAL( 2, popAll( queue, 2000, order, kinds ) );
+    LONGS_EQUAL( kConnTimerTransmission, kinds[0] );
+    LONGS_EQUAL( kConnTimerWatchdog, kinds[1] );
+}
+
+
+TEST( ConnTimerQueue, RemoveKeepsHeapOrder )
+{
+    ConnTimerQueue  queue;
+    CipConn*        order[DIM( conns )];
+
+    for( int i = 0; i < DIM( conns );  ++i )
+    {
+        conns[i].deadline_usecs[kConnTimerWatchdog] = 1000 * ( DIM( conns ) - i );
+        queue.Insert( &conns[i], kConnTimerWatchdog );
+    }
+
+    // the earliest, a leaf and one in between
+    queue.Remove( &conns[DIM( conns ) - 1], kConnTimerWatchdog );
+    queue.Remove( &conns[0], kConnTimerWatchdog );
+    queue.Remove( &conns[7], kConnTimerWatchdog );
+
+    LONGS_EQUAL( -1, conns[7].timer_pos[kConnTimerWatchdog] );
+
+    // a second removal is a no-op
+    queue.Remove( &conns[7], kConnTimerWatchdog );
+
+    int count = popAll( queue, kConnTimerNever - 1, order );
+
+    LONGS_EQUAL( DIM( conns ) - 3, count );
+
+    for( int i = 1; i < count;  ++i )
+    {
+        CHECK( order[i - 1]->deadline_usecs[kConnTimerWatchdog] <
+               order[i]->deadline_usecs[kConnTimerWatchdog] );
+    }
+}
+
+
+TEST( ConnTimerQueue, EarlierDeadlineSiftsUp )
+{
+    ConnTimerQueue  queue;
+    CipConn*        order[DIM( conns )];
+
+    for( int i = 0; i < DIM( conns );  ++i )
+    {
+        conns[i].deadline_usecs[kConnTimerTransmission] = 1000 * ( i + 1 );
+        queue.Insert( &conns[i], kConnTimerTransmission );
+    }
+
+    conns[12].deadline_usecs[kConnTimerTransmission] = 500;
+    queue.Reschedule( &conns[12], kConnTimerTransmission );
+
+    CHECK( 500 == queue.NextDeadline() );
+
+    LONGS_EQUAL( 1, popAll( queue, 999, order ) );
+    POINTERS_EQUAL( &conns[12], order[0] );
+
+    // re-armed after being popped, as ManageConnectionTimers() does
+    conns[12].deadline_usecs[kConnTimerTransmission] = 2500;
+    queue.Reschedule( &conns[12], kConnTimerTransmission );
+
+    LONGS_EQUAL( 3, popAll( queue, 2500, order ) );
+    POINTERS_EQUAL( &conns[0], order[0] );
+    POINTERS_EQUAL( &conns[1], order[1] );
+    POINTERS_EQUAL( &conns[12], order[2] );
+}
+
+
+TEST( ConnTimerQueue, LaterDeadlineIsRequeuedLazily )
+{
+    ConnTimerQueue  queue;
+    CipConn*        order[DIM( conns )];
+
+    for( int i = 0; i < 4;  ++i )
+    {
+        conns[i].deadline_usecs[kConnTimerWatchdog] = 1000 * ( i + 1 );
+        queue.Insert( &conns[i], kConnTimerWatchdog );
+    }
+
+    // a packet arrived: the watchdog moves later, its key stays stale
+    conns[0].deadline_usecs[kConnTimerWatchdog] = 3500;
+    queue.Reschedule( &conns[0], kConnTimerWatchdog );
+
+    CHECK( 1000 == queue.NextDeadline() );
+
+    // the stale key comes due but the connection has not expired
+    LONGS_EQUAL( 0, popAll( queue, 1500, order ) );
+    CHECK( 2000 == queue.NextDeadline() );
+
+    LONGS_EQUAL( 3, popAll( queue, 3500, order ) );
+    POINTERS_EQUAL( &conns[1], order[0] );
+    POINTERS_EQUAL( &conns[2], order[1] );
+    POINTERS_EQUAL( &conns[0], order[2] );
+
+    CHECK( 4000 == queue.NextDeadline() );
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <CppUTest/TestHarness.h>
+
+#include "cipevents.h"
+
+
+// Pops and discards whatever an earlier test left in the ring.
+static void drain()
+{
+    CipsterEvent event;
+
+    while( PopCipsterEvent( &event ) )
+        ;
+}
+
+
+TEST_GROUP( EventRing )
+{
+    void setup()
+    {
+        drain();
+    }
+};
+
+
+TEST( EventRing, EventsComeOutInOrder )
+{
+    CipsterEvent    event;
+    CipInstance     instance( 150 );
+
+    CHECK_FALSE( PopCipsterEvent( &event ) );
+
+    LONGS_EQUAL( kEipStatusOk, NotifyAssemblyDataReceived( &instance ) );
+    NotifyIoConnectionEvent( 150, 100, kIoConnectionEventTimedOut );
+    NotifyRunIdleChanged( 1 );
+
+    CHECK( PopCipsterEvent( &event ) );
+    LONGS_EQUAL( kCipsterEventAssemblyDataReceived, event.type );
+    LONGS_EQUAL( 150, event.instance_id );
+
+    CHECK( PopCipsterEvent( &event ) );
+    LONGS_EQUAL( kCipsterEventIoConnection, event.type );
+    LONGS_EQUAL( kIoConnectionEventTimedOut, event.io_event );
+    LONGS_EQUAL( 150, event.instance_id );
+    LONGS_EQUAL( 100, event.value );
+
+    CHECK( PopCipsterEvent( &event ) );
+    LONGS_EQUAL( kCipsterEventRunIdleChanged, event.type );
+    LONGS_EQUAL( 1, event.value );
+
+    CHECK_FALSE( PopCipsterEvent( &event ) );
+}
+
+
+TEST( EventRing, OverflowIsCountedAndRingRecovers )
+{
+    CipsterEvent    event;
+    EipUint32       lost = CipsterEventOverflows();
+    unsigned        capacity = 0;
+
+    // fill it, numbering each event, until one is lost
+    while( CipsterEventOverflows() == lost )
+        NotifyRunIdleChanged( capacity++ );
+
+    --capacity;
+
+    CHECK( capacity > 0 );
+    LONGS_EQUAL( 0, capacity & ( capacity - 1 ) );
+
+    NotifyRunIdleChanged( 0xdead );
+    LONGS_EQUAL( lost + 2, CipsterEventOverflows() );
+
+    // the ones which fit are intact, the lost ones were not written over them
+    for( unsigned i = 0; i < capacity;  ++i )
+    {
+        CHECK( PopCipsterEvent( &event ) );
+        LONGS_EQUAL( i, event.value );
+    }
+
+    CHECK_FALSE( PopCipsterEvent( &event ) );
+
+    // the indices wrapped, and a freed slot takes an event again
+    NotifyRunIdleChanged( 7 );
+
+    CHECK( PopCipsterEvent( &event ) );
+    LONGS_EQUAL( 7, event.value );
+    LONGS_EQUAL( lost + 2, CipsterEventOverflows() );
+}
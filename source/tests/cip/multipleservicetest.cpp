@@ -0,0 +1,164 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include <CppUTest/TestHarness.h>
+
+#include "cipmessagerouter.h"
+#include "ciperror.h"
+
+
+// Get_Attribute_Single of the Message Router class revision, replies UINT 1
+static const EipByte getRevision[] = { 0x0e, 0x03, 0x20, 0x02, 0x24, 0x00, 0x30, 0x01 };
+
+// Get_Attribute_Single of a class attribute which does not exist
+static const EipByte getMissing[]  = { 0x0e, 0x03, 0x20, 0x02, 0x24, 0x00, 0x30, 0x63 };
+
+
+/**
+ * Function buildPacket
+ * puts into aPacket a Multiple Service Packet request to the Message Router
+ * instance holding aCount embedded requests of aLength bytes each, and
+ * returns its length.  aOffsets overrides the offset table when not NULL.
+ */
+static int buildPacket( EipByte* aPacket, int aCount, const EipByte* const* aRequests,
+        int aLength, const EipUint16* aOffsets = NULL )
+{
+    static const EipByte header[] = { 0x0a, 0x02, 0x20, 0x02, 0x24, 0x01 };
+
+    BufWriter out( aPacket, 600 );
+
+    out.append( header, sizeof header );
+    out.put16( aCount );
+
+    for( int i = 0; i < aCount;  ++i )
+        out.put16( aOffsets ? aOffsets[i] : 2 + 2 * aCount + i * aLength );
+
+    for( int i = 0; i < aCount;  ++i )
+        out.append( aRequests[i], aLength );
+
+    return out.data() - aPacket;
+}
+
+
+TEST_GROUP( MultipleServicePacket )
+{
+    EipByte packet[600];
+
+    void setup()
+    {
+        CipMessageRouterInit();
+    }
+
+    void teardown()
+    {
+        DeleteAllClasses();
+    }
+};
+
+
+TEST( MultipleServicePacket, RepliesInOrder )
+{
+    const EipByte* requests[] = { getRevision, getMissing, getRevision };
+
+    int length = buildPacket( packet, 3, requests, sizeof getRevision );
+
+    CipMessageRouterResponse reply( NULL );
+
+    NotifyMR( BufReader( packet, length ), &reply );
+
+    LONGS_EQUAL( kMultipleServicePacket, reply.reply_service );
+    LONGS_EQUAL( kCipErrorEmbeddedServiceError, reply.general_status );
+
+    BufReader in = reply.Payload();
+
+    LONGS_EQUAL( 3, in.get16() );
+
+    unsigned offsets[3];
+
+    for( int i = 0; i < 3;  ++i )
+        offsets[i] = in.get16();
+
+    LONGS_EQUAL( 8, offsets[0] );
+
+    // a good reply, the failed one without data, then a good one again
+    static const EipByte good[] = { 0x8e, 0, kCipErrorSuccess, 0, 0x01, 0x00 };
+
+    MEMCMP_EQUAL( good, reply.data.data() + offsets[0], sizeof good );
+    LONGS_EQUAL( offsets[0] + sizeof good, offsets[1] );
+
+    BufReader failed( reply.data.data() + offsets[1], offsets[2] - offsets[1] );
+
+    LONGS_EQUAL( 0x8e, failed.get8() );
+    LONGS_EQUAL( 0, failed.get8() );
+    CHECK( failed.get8() != kCipErrorSuccess );
+
+    MEMCMP_EQUAL( good, reply.data.data() + offsets[2], sizeof good );
+    LONGS_EQUAL( offsets[2] + sizeof good, reply.data_length );
+}
+
+
+TEST( MultipleServicePacket, BadOffsetsAreRejected )
+{
+    const EipByte* requests[] = { getRevision, getRevision };
+
+    // into the offset table, out of order, and past the end
+    static const EipUint16 bad[][2] = { { 4, 14 }, { 14, 6 }, { 6, 40 } };
+
+    for( int i = 0; i < DIM( bad );  ++i )
+    {
+        int length = buildPacket( packet, 2, requests, sizeof getRevision, bad[i] );
+
+        CipMessageRouterResponse reply( NULL );
+
+        NotifyMR( BufReader( packet, length ), &reply );
+
+        LONGS_EQUAL( kCipErrorInvalidParameter, reply.general_status );
+        LONGS_EQUAL( 0, reply.data_length );
+    }
+}
+
+
+TEST( MultipleServicePacket, ShortOffsetTable )
+{
+    const EipByte* requests[] = { getRevision };
+
+    int length = buildPacket( packet, 1, requests, 0 );
+
+    // claim three requests with room for the offsets of only two
+    packet[6] = 3;
+
+    CipMessageRouterResponse reply( NULL );
+
+    NotifyMR( BufReader( packet, length + 2 ), &reply );
+
+    LONGS_EQUAL( kCipErrorNotEnoughData, reply.general_status );
+}
+
+
+TEST( MultipleServicePacket, ReplyTooLarge )
+{
+    const EipByte* requests[] = { getRevision, getRevision };
+
+    int length = buildPacket( packet, 2, requests, sizeof getRevision );
+
+    // with no room for the first reply's header, then for its data
+    static const int sizes[] = { 4, 12, 15 };
+
+    for( int i = 0; i < DIM( sizes );  ++i )
+    {
+        EipByte buf[16];
+
+        CipMessageRouterResponse reply( NULL );
+
+        reply.data = BufWriter( buf, sizes[i] );
+
+        NotifyMR( BufReader( packet, length ), &reply );
+
+        LONGS_EQUAL( kCipErrorReplyDataTooLarge, reply.general_status );
+        LONGS_EQUAL( 0, reply.data_length );
+    }
+}
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * Copyright (c) 2016, SoftPLC Corportion.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include <CppUTest/TestHarness.h>
+
+#include "ciptypedattribute.h"
+#include "ciperror.h"
+
+
+/**
+ * Function roundTrip
+ * reads aValue through a TypedAttribute<T>, checks the bytes against those
+ * of GetAttrData() for the same CIP type, then writes them back into a
+ * second attribute, with aCapacity bytes of room for a string, and returns
+ * its value.
+ */
+template< class T >
+static T roundTrip( T aValue, T aInitial, int aLength, unsigned aCapacity = 0 )
+{
+    T               result = aInitial;
+    EipByte         typed[32];
+    EipByte         generic[32];
+
+    TypedAttribute<T>   source( 1, 0, &aValue );
+    TypedAttribute<T>   target( 1, 0, &result, CipCodec<T>::cip_type, aCapacity );
+
+    CipMessageRouterRequest     request;
+    CipMessageRouterResponse    reply( NULL );
+
+    reply.data = BufWriter( typed, sizeof typed );
+    TypedAttribute<T>::get( &source, &request, &reply );
+    LONGS_EQUAL( aLength, reply.data_length );
+
+    CipMessageRouterResponse    generic_reply( NULL );
+
+    generic_reply.data = BufWriter( generic, sizeof generic );
+    GetAttrData( &source, &request, &generic_reply );
+    LONGS_EQUAL( aLength, generic_reply.data_length );
+    MEMCMP_EQUAL( generic, typed, aLength );
+
+    request.data = BufReader( typed, aLength );
+    TypedAttribute<T>::set( &target, &request, &reply );
+    LONGS_EQUAL( kCipErrorSuccess, reply.general_status );
+
+    return result;
+}
+
+
+TEST_GROUP( TypedAttribute )
+{
+};
+
+
+TEST( TypedAttribute, Integers )
+{
+    LONGS_EQUAL( 0xa5, roundTrip<EipUint8>( 0xa5, 0, 1 ) );
+    LONGS_EQUAL( -3, roundTrip<EipInt8>( -3, 0, 1 ) );
+    LONGS_EQUAL( 0xbeef, roundTrip<EipUint16>( 0xbeef, 0, 2 ) );
+    LONGS_EQUAL( -12345, roundTrip<EipInt16>( -12345, 0, 2 ) );
+    CHECK( 0xdeadbeef == roundTrip<EipUint32>( 0xdeadbeef, 0, 4 ) );
+    LONGS_EQUAL( -123456789, roundTrip<EipInt32>( -123456789, 0, 4 ) );
+    CHECK( 0xECD061460FA67E51ull == roundTrip<EipUint64>( 0xECD061460FA67E51ull, 0, 8 ) );
+    CHECK( -2 == roundTrip<EipInt64>( -2, 0, 8 ) );
+}
+
+
+TEST( TypedAttribute, Reals )
+{
+    CHECK( 1.5f == roundTrip<EipFloat>( 1.5f, 0, 4 ) );
+    CHECK( -0.1 == roundTrip<EipDfloat>( -0.1, 0, 8 ) );
+}
+
+
+TEST( TypedAttribute, Structs )
+{
+    CipRevision     rev = { 3, 14 };
+    CipRevision     zero_rev = { 0, 0 };
+
+    CipRevision     got_rev = roundTrip( rev, zero_rev, 2 );
+
+    LONGS_EQUAL( 3, got_rev.major_revision );
+    LONGS_EQUAL( 14, got_rev.minor_revision );
+}
+
+
+TEST( TypedAttribute, OddStringIsPadded )
+{
+    EipByte     text[] = "abcde";
+    EipByte     room[8] = {};
+
+    CipString   value = { 5, text };
+    CipString   initial = { 0, room };
+
+    CipString   got = roundTrip( value, initial, 2 + 5 + 1, sizeof room );
+
+    LONGS_EQUAL( 5, got.length );
+    POINTERS_EQUAL( room, got.string );
+    MEMCMP_EQUAL( "abcde", room, 5 );
+}
+
+
+TEST( TypedAttribute, BadLengthLeavesValue )
+{
+    EipUint32   value = 7;
+    EipByte     data[] = { 1, 2, 3, 4, 5 };
+
+    TypedAttribute<EipUint32>   attr( 1, 0, &value );
+
+    CipMessageRouterRequest     request;
+    CipMessageRouterResponse    reply( NULL );
+
+    request.data = BufReader( data, 3 );
+    TypedAttribute<EipUint32>::set( &attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorNotEnoughData, reply.general_status );
+    LONGS_EQUAL( 7, value );
+
+    reply.Clear();
+    request.data = BufReader( data, 5 );
+    TypedAttribute<EipUint32>::set( &attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorTooMuchData, reply.general_status );
+    LONGS_EQUAL( 7, value );
+
+    reply.Clear();
+    request.data = BufReader( data, 4 );
+    TypedAttribute<EipUint32>::set( &attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorSuccess, reply.general_status );
+    LONGS_EQUAL( 0x04030201, value );
+
+    EipByte     room[4] = { 'w', 'x', 'y', 'z' };
+    CipString   text = { 4, room };
+
+    TypedAttribute<CipString>   text_attr( 1, 0, &text, kCipString, sizeof room );
+
+    // 5 bytes do not fit the 4 of room
+    EipByte     too_long[] = { 5, 0, 'a', 'b', 'c', 'd', 'e', 0 };
+
+    reply.Clear();
+    request.data = BufReader( too_long, sizeof too_long );
+    TypedAttribute<CipString>::set( &text_attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorTooMuchData, reply.general_status );
+    LONGS_EQUAL( 4, text.length );
+    POINTERS_EQUAL( room, text.string );
+    MEMCMP_EQUAL( "wxyz", room, 4 );
+
+    // fits, but a byte follows the pad
+    EipByte     trailing[] = { 3, 0, 'a', 'b', 'c', 0, 9 };
+
+    reply.Clear();
+    request.data = BufReader( trailing, sizeof trailing );
+    TypedAttribute<CipString>::set( &text_attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorTooMuchData, reply.general_status );
+    LONGS_EQUAL( 4, text.length );
+    MEMCMP_EQUAL( "wxyz", room, 4 );
+
+    reply.Clear();
+    request.data = BufReader( trailing, 6 );
+    TypedAttribute<CipString>::set( &text_attr, &request, &reply );
+    LONGS_EQUAL( kCipErrorSuccess, reply.general_status );
+    LONGS_EQUAL( 3, text.length );
+    POINTERS_EQUAL( room, text.string );
+    MEMCMP_EQUAL( "abcz", room, 4 );
+}
@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Copyright (c) 2009, Rockwell Automation, Inc.
+ *
+ ******************************************************************************/
+
+#include <CppUTest/TestHarness.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+
+#include "byte_bufs.h"
+
+#include "ciptypes.h"
+
+
+TEST_GROUP( ByteBufs )
+{
+};
+
+
+TEST( ByteBufs, Get16 )
+{
+    CipOctet    test_message[] = { 8, 60 };
+    BufReader   in( test_message, sizeof test_message );
+    EipUint16   returned_value = in.get16();
+
+    LONGS_EQUAL( 15368, returned_value );
+    POINTERS_EQUAL( test_message + 2, in.data() );
+}
+
+
+TEST( ByteBufs, Get32 )
+{
+    CipOctet    test_message[] = { 28, 53, 41, 37 };
+    BufReader   in( test_message, sizeof test_message );
+    EipUint32   returned_value = in.get32();
+
+    LONGS_EQUAL( 623457564, returned_value );
+    POINTERS_EQUAL( test_message + 4, in.data() );
+}
+
+
+TEST( ByteBufs, Get64 )
+{
+    CipOctet    test_message[] = { 81, 126, 166, 15, 70, 97, 208, 236 };
+    BufReader   in( test_message, sizeof test_message );
+    EipUint64   returned_value = in.get64();
+
+    CHECK( 0xECD061460FA67E51ull == returned_value );
+    POINTERS_EQUAL( test_message + 8, in.data() );
+}
+
+
+TEST( ByteBufs, Put16 )
+{
+    CipOctet    message[2];
+    BufWriter   out( message, sizeof message );
+
+    out.put16( 0x5499 );
+
+    BYTES_EQUAL( 0x99, message[0] );
+    BYTES_EQUAL( 0x54, message[1] );
+
+    POINTERS_EQUAL( message + 2, out.data() );
+}
+
+
+TEST( ByteBufs, Put32 )
+{
+    CipOctet    message[4];
+    BufWriter   out( message, sizeof message );
+
+    out.put32( 0x25E0C459 );
+
+    BYTES_EQUAL( 0x59, message[0] );
+    BYTES_EQUAL( 0xC4, message[1] );
+    BYTES_EQUAL( 0xE0, message[2] );
+    BYTES_EQUAL( 0x25, message[3] );
+
+    POINTERS_EQUAL( message + 4, out.data() );
+}
+
+
+TEST( ByteBufs, Put64 )
+{
+    CipOctet    message[8];
+    BufWriter   out( message, sizeof message );
+
+    out.put64( 0x2D2AEF0B84095230ull );
+
+    BYTES_EQUAL( 0x30, message[0] );
+    BYTES_EQUAL( 0x52, message[1] );
+    BYTES_EQUAL( 0x09, message[2] );
+    BYTES_EQUAL( 0x84, message[3] );
+    BYTES_EQUAL( 0x0B, message[4] );
+    BYTES_EQUAL( 0xEF, message[5] );
+    BYTES_EQUAL( 0x2A, message[6] );
+    BYTES_EQUAL( 0x2D, message[7] );
+
+    POINTERS_EQUAL( message + 8, out.data() );
+}
+
+
+TEST( ByteBufs, PutBigEndian )
+{
+    CipOctet    message[6];
+    BufWriter   out( message, sizeof message );
+
+    out.put16BE( 0xAF12 );
+    out.put32BE( 0x25E0C459 );
+
+    BYTES_EQUAL( 0xAF, message[0] );
+    BYTES_EQUAL( 0x12, message[1] );
+    BYTES_EQUAL( 0x25, message[2] );
+    BYTES_EQUAL( 0xE0, message[3] );
+    BYTES_EQUAL( 0xC4, message[4] );
+    BYTES_EQUAL( 0x59, message[5] );
+}
+
+
+TEST( ByteBufs, Advance )
+{
+    CipOctet    message[8];
+    BufWriter   out( message, sizeof message );
+
+    out += 4;
+
+    POINTERS_EQUAL( message + 4, out.data() );
+    LONGS_EQUAL( 4, out.size() );
+}
+
+
+TEST( ByteBufs, Fill )
+{
+    CipOctet    message[8];
+    BufWriter   out( message, sizeof message );
+
+    memset( message, 15, 8 );
+
+    out.fill( 8 );
+
+    for( int i = 0; i < 8;  ++i )
+        BYTES_EQUAL( 0, message[i] );
+
+    POINTERS_EQUAL( message + 8, out.data() );
+}
+
+
+TEST( ByteBufs, Overrun )
+{
+    CipOctet    message[3];
+    BufWriter   out( message, sizeof message );
+    BufReader   in( message, sizeof message );
+    bool        wthrew = false;
+    bool        rthrew = false;
+
+    try
+    {
+        out.put32( 0 );
+    }
+    catch( const std::overflow_error& )
+    {
+        wthrew = true;
+    }
+
+    try
+    {
+        in.get32();
+    }
+    catch( const std::range_error& )
+    {
+        rthrew = true;
+    }
+
+    CHECK( wthrew );
+    CHECK( rthrew );
+}
@@ -8,10 +8,8 @@
 #include <CppUTest/TestHarness.h>
 #include <stdint.h>
 
-extern "C"  {
 #include <random.h>
 #include <xorshiftrandom.h>
-}
 
 TEST_GROUP(RandomClass)
 {
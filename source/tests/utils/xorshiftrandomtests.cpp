@@ -8,9 +8,7 @@
 #include <CppUTest/TestHarness.h>
 #include <stdint.h>
 
-extern "C"  {
 #include <xorshiftrandom.h>
-}
 
 TEST_GROUP(XorShiftRandom)
 {